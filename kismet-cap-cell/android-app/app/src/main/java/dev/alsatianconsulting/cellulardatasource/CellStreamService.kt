@@ -18,7 +18,10 @@ import java.util.concurrent.CountDownLatch
 import java.util.concurrent.TimeUnit
 import org.json.JSONArray
 import org.json.JSONObject
+import com.github.luben.zstd.Zstd
+import com.github.luben.zstd.ZstdOutputStream
 import java.io.BufferedWriter
+import java.io.OutputStream
 import java.io.OutputStreamWriter
 import java.net.ServerSocket
 import java.net.Socket
@@ -43,6 +46,9 @@ class CellStreamService : Service() {
         private const val TRANSPORT_USB = "usb"
         private const val NOTIFICATION_ID = 1
         private const val NOTIFICATION_CHANNEL_ID = "cellstream"
+        // Time a new stream client gets to ask for compression before plain JSON starts
+        private const val STREAM_HELLO_TIMEOUT_MS = 500
+        private const val ZSTD_LEVEL = 3
     }
     // Use a non-adb port to avoid clashing with wireless-debugging (adb over TCP uses 5555).
     private val port = 8765
@@ -77,6 +83,14 @@ class CellStreamService : Service() {
     @Volatile private var lastPiClientSeenMs: Long = 0L
     @Volatile private var lastListenerEventMs: Long = 0L
     @Volatile private var listenerRegistered: Boolean = false
+    // Shared dictionary from train_zstd_dict.sh, bundled as assets/cell.zdict
+    private val zstdDict: ByteArray? by lazy {
+        try {
+            assets.open("cell.zdict").use { it.readBytes() }
+        } catch (_: Exception) {
+            null
+        }
+    }
 
     override fun onCreate() {
         super.onCreate()
@@ -181,7 +195,7 @@ class CellStreamService : Service() {
     private fun handleClient(sock: Socket) {
         try {
             sock.use { s ->
-                val out = BufferedWriter(OutputStreamWriter(s.getOutputStream()))
+                val out = BufferedWriter(OutputStreamWriter(openStream(s)))
                 while (running && !s.isClosed) {
                     try {
                         val payload = collectOnce()
@@ -199,6 +213,11 @@ class CellStreamService : Service() {
                     }
                     if (!safeSleep(2000)) break
                 }
+                // Ends the zstd frame and frees the native encoder
+                try {
+                    out.close()
+                } catch (_: Exception) {
+                }
             }
         } finally {
             val remaining = activeStreamClients.decrementAndGet()
@@ -206,6 +225,47 @@ class CellStreamService : Service() {
         }
     }
 
+    // A helper started with compress=zstd sends {"stream":"zstd","dict":<id>}
+    // right after connecting.  It gets a zstd stream, using the bundled
+    // dictionary if the ids match; anything else gets plain JSON lines.
+    private fun openStream(s: Socket): OutputStream {
+        val raw = s.getOutputStream()
+        val hello = readHello(s) ?: return raw
+        if (hello.optString("stream") != "zstd") return raw
+        return try {
+            val zout = ZstdOutputStream(raw, ZSTD_LEVEL)
+            val dict = zstdDict
+            if (dict != null && hello.optLong("dict", 0L) == Zstd.getDictIdFromDict(dict)) {
+                zout.setDict(dict)
+            }
+            zout
+        } catch (_: Exception) {
+            raw
+        }
+    }
+
+    private fun readHello(s: Socket): JSONObject? {
+        val prevTimeout = s.soTimeout
+        return try {
+            s.soTimeout = STREAM_HELLO_TIMEOUT_MS
+            val input = s.getInputStream()
+            val line = StringBuilder()
+            while (line.length < 256) {
+                val c = input.read()
+                if (c < 0 || c == '\n'.code) break
+                line.append(c.toChar())
+            }
+            JSONObject(line.toString())
+        } catch (_: Exception) {
+            null
+        } finally {
+            try {
+                s.soTimeout = prevTimeout
+            } catch (_: Exception) {
+            }
+        }
+    }
+
     private fun runNmeaServer() {
         while (running) {
             if (!isUsbTransportEnabled()) {
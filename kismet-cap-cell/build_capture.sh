@@ -2,13 +2,40 @@
 set -euo pipefail
 SRC_DIR=$(cd -- "$(dirname "$0")" && pwd)
 cd "$SRC_DIR"
+
+# Compressed phone streams (compress=zstd) need libzstd; without it the
+# helper still builds and takes plain JSON only
+ZSTD_CFLAGS=()
+ZSTD_LIBS=()
+if pkg-config --exists libzstd 2>/dev/null; then
+  read -r -a ZSTD_CFLAGS <<< "-DHAVE_ZSTD $(pkg-config --cflags libzstd)"
+  read -r -a ZSTD_LIBS <<< "$(pkg-config --libs libzstd)"
+else
+  echo "libzstd not found (apt install libzstd-dev); building without compressed stream support" >&2
+fi
+
+# ./build_capture.sh check: round-trip the stream decoder instead of building
+if [ "${1:-}" = check ]; then
+  if [ ${#ZSTD_LIBS[@]} -eq 0 ]; then
+    echo "libzstd not found; nothing to check" >&2
+    exit 1
+  fi
+  cc "${ZSTD_CFLAGS[@]}" cell_stream_check.c cell_stream.c \
+    -lpthread "${ZSTD_LIBS[@]}" -o cell_stream_check
+  exec ./cell_stream_check
+fi
+
 cc \
   -Ivendor -Ivendor/protobuf_c_1005000 \
+  "${ZSTD_CFLAGS[@]}" \
   capture_cell.c \
+  cell_gps.c \
+  cell_normalize.c \
+  cell_stream.c \
   vendor/capture_framework.c \
   vendor/simple_ringbuf_c.c \
   vendor/kis_external_packet.c \
   vendor/mpack/mpack.c \
   vendor/version_stub.c \
   vendor/protobuf_c_1005000/*.c \
-  -lpthread -lprotobuf-c -o kismet_cap_cell_capture
+  -lpthread -lprotobuf-c -lm "${ZSTD_LIBS[@]}" -o kismet_cap_cell_capture
@@ -0,0 +1,7 @@
+#!/usr/bin/env bash
+set -euo pipefail
+SRC_DIR=$(cd -- "$(dirname "$0")" && pwd)
+cd "$SRC_DIR"
+c++ -std=c++17 -O2 \
+  cell_query.cpp \
+  -lpthread -o cell_query
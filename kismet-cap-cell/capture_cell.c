@@ -6,11 +6,17 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <poll.h>
 #include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "vendor/config.h"
@@ -18,9 +24,21 @@
 #include "vendor/simple_ringbuf_c.h"
 #include "vendor/kis_external_packet.h"
 
+#include "cell_gps.h"
+#include "cell_normalize.h"
+#include "cell_record.h"
+#include "cell_stream.h"
+
 #define DEFAULT_HOST "127.0.0.1"
 #define DEFAULT_PORT 8765
 
+/* How often pipeline counters are forwarded to Kismet as a cellstats frame */
+#define STATS_INTERVAL_SEC 10
+
+/* How far past the newest phone fix a frame may be and still get a
+ * dead-reckoned position */
+#define GPS_MAX_EXTRAP_SEC 3.0
+
 static uint64_t fnv1a64(const char *s) {
     uint64_t h = 1469598103934665603ULL;
     while (s && *s) {
@@ -59,13 +77,30 @@ static void make_source_uuid(const char *host, int port, char out[37]) {
              b[10], b[11], b[12], b[13], b[14], b[15]);
 }
 
-static void parse_definition_endpoint(const char *definition, char **host_out, int *port_out) {
+/*
+ * Stream endpoint from the source definition: tcp://HOST:PORT, or a UNIX
+ * socket as uds:///path, uds:/path or, for the abstract namespace, uds://@name;
+ * the path can't hold ',' or ':'.  uds_out is NULL for TCP.
+ */
+static void parse_definition_endpoint(const char *definition, char **host_out, int *port_out,
+                                      char **uds_out) {
     char *host = strdup(DEFAULT_HOST);
     int port = DEFAULT_PORT;
+    char *uds = NULL;
 
     if (definition) {
         const char *tcp = strstr(definition, "tcp://");
-        if (tcp) {
+        const char *unix_sock = strstr(definition, "uds:");
+        if (unix_sock) {
+            const char *p = unix_sock + strlen("uds:");
+            if (strncmp(p, "//", 2) == 0)
+                p += 2;
+            /* Ends at the next option, either a ',' or the ':' before
+             * name=... as in the multi_phone.sh layout */
+            size_t len = strcspn(p, ",:");
+            if (len > 0)
+                uds = strndup(p, len);
+        } else if (tcp) {
             const char *h = tcp + strlen("tcp://");
             const char *colon = strchr(h, ':');
             if (colon) {
@@ -83,21 +118,54 @@ static void parse_definition_endpoint(const char *definition, char **host_out, i
 
     *host_out = host;
     *port_out = port;
+    *uds_out = uds;
 }
 
+/*
+ * Pipeline counters; only touched from the reader thread so plain integers do,
+ * and they're cumulative since helper start (Kismet treats them as counters)
+ */
+typedef struct {
+    uint64_t frames;
+    /* Decoded JSON; wire bytes are counted by the stream decoder */
+    uint64_t bytes;
+    uint64_t malformed;
+    uint64_t normalized;
+    uint64_t gps_attached;
+    uint64_t oversize_drops;
+    uint64_t reconnects;
+    uint64_t send_errors;
+    uint64_t send_full;
+    uint64_t send_blocked_us;
+    time_t last_sent;
+} cell_stats_t;
+
 /*
  * Userdata for this capture instance
  */
 typedef struct {
     char *host;
     int port;
+    /* UNIX socket path, '@' prefix for the abstract namespace; NULL for TCP */
+    char *uds_path;
     int sockfd;
     pthread_t reader_thread;
     int running;
+    /* Parse in the helper and send cell_record_t instead of JSON */
+    int normalize;
+    /* Phone NMEA feed; gps_port 0 when disabled */
+    char *gps_host;
+    int gps_port;
+    int gps_sockfd;
+    pthread_t gps_thread;
+    cell_gps_t gps;
+    /* Plain or zstd, decided per connection */
+    cell_stream_t stream;
+    cell_stats_t stats;
 } cell_cap_t;
 
 static void usage(const char *prog) {
-    fprintf(stderr, "Usage: %s [--host HOST] [--port PORT]\n", prog);
+    fprintf(stderr, "Usage: %s [--host HOST] [--port PORT] [--uds PATH|@NAME]\n", prog);
 }
 
 static int connect_socket(const char *host, int port) {
@@ -118,28 +186,314 @@ static int connect_socket(const char *host, int port) {
     return fd;
 }
 
+static int connect_uds(const char *path) {
+    struct sockaddr_un addr;
+    size_t len = strlen(path);
+    socklen_t addrlen;
+
+    if (len == 0 || len >= sizeof(addr.sun_path))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path[0] == '@') {
+        /* Abstract: leading NUL, and the length counts only the name bytes */
+        memcpy(addr.sun_path + 1, path + 1, len - 1);
+        addrlen = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + len);
+    } else {
+        memcpy(addr.sun_path, path, len);
+        addrlen = (socklen_t) sizeof(addr);
+    }
+
+    if (connect(fd, (struct sockaddr *) &addr, addrlen) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int connect_stream(cell_cap_t *cap) {
+    if (cap->uds_path != NULL)
+        return connect_uds(cap->uds_path);
+    return connect_socket(cap->host, cap->port);
+}
+
+static uint64_t elapsed_us(const struct timeval *a, const struct timeval *b) {
+    return (uint64_t) (b->tv_sec - a->tv_sec) * 1000000 + (b->tv_usec - a->tv_usec);
+}
+
+/* Send a JSON frame, or a normalized record when rec is set, waiting for
+ * ringbuffer space rather than dropping; time spent waiting is accounted as
+ * blocked time */
+static int send_blocking(kis_capture_handler_t *caph, cell_cap_t *cap,
+                         struct timeval tv, struct cf_params_gps *gps,
+                         const char *type, const char *json, cell_record_t *rec) {
+    struct timeval wait_start;
+    int waited = 0;
+
+    while (cap->running) {
+        int r;
+        if (rec != NULL)
+            r = cf_send_data(caph,
+                             NULL, /* message */
+                             0,    /* msg_type */
+                             NULL, /* signal */
+                             gps,
+                             tv,
+                             CELL_RECORD_DLT,
+                             sizeof(cell_record_t),
+                             sizeof(cell_record_t),
+                             (uint8_t *) rec);
+        else
+            r = cf_send_json(caph,
+                             NULL, /* message */
+                             0,    /* msg_type */
+                             NULL, /* signal */
+                             gps,
+                             tv,
+                             type,
+                             json);
+        if (r < 0) {
+            cap->stats.send_errors++;
+            return -1;
+        }
+        if (r > 0) {
+            if (waited) {
+                struct timeval now;
+                gettimeofday(&now, NULL);
+                cap->stats.send_blocked_us += elapsed_us(&wait_start, &now);
+            }
+            return 1;
+        }
+
+        if (!waited) {
+            cap->stats.send_full++;
+            gettimeofday(&wait_start, NULL);
+            waited = 1;
+        }
+        cf_handler_wait_ringbuffer(caph);
+    }
+
+    return 0;
+}
+
+/* Copy in as the body of a JSON string; an escape that wouldn't fit is
+ * dropped whole so the output always stays valid */
+static void json_escape(char *out, size_t out_len, const char *in) {
+    size_t o = 0;
+
+    for (; *in != '\0'; in++) {
+        unsigned char c = (unsigned char) *in;
+        char esc[8];
+        int n;
+
+        if (c == '"' || c == '\\')
+            n = snprintf(esc, sizeof(esc), "\\%c", c);
+        else if (c < 0x20)
+            n = snprintf(esc, sizeof(esc), "\\u%04x", c);
+        else
+            n = snprintf(esc, sizeof(esc), "%c", c);
+
+        if (o + (size_t) n >= out_len)
+            break;
+        memcpy(out + o, esc, (size_t) n);
+        o += (size_t) n;
+    }
+
+    out[o] = '\0';
+}
+
+static void send_stats(kis_capture_handler_t *caph, cell_cap_t *cap) {
+    size_t queue_used = 0, queue_size = 0;
+    char json[1536];
+    char endpoint[160];
+    char endpoint_json[320];
+    struct timeval tv;
+    struct timespec cpu;
+    uint64_t cpu_us = 0;
+
+    /* Called from the reader thread, so this is its CPU time: parsing,
+     * decompression and framing together */
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu) == 0)
+        cpu_us = (uint64_t) cpu.tv_sec * 1000000 + cpu.tv_nsec / 1000;
+
+    if (caph->out_ringbuf != NULL) {
+        pthread_mutex_lock(&(caph->out_ringbuf_lock));
+        queue_used = kis_simple_ringbuf_used(caph->out_ringbuf);
+        queue_size = kis_simple_ringbuf_size(caph->out_ringbuf);
+        pthread_mutex_unlock(&(caph->out_ringbuf_lock));
+    }
+
+    if (cap->uds_path != NULL)
+        snprintf(endpoint, sizeof(endpoint), "uds:%s", cap->uds_path);
+    else
+        snprintf(endpoint, sizeof(endpoint), "%s:%d", cap->host, cap->port);
+    /* The host and socket path come from the source definition as typed */
+    json_escape(endpoint_json, sizeof(endpoint_json), endpoint);
+
+    snprintf(json, sizeof(json),
+             "{\"endpoint\":\"%s\",\"frames\":%llu,\"bytes\":%llu,\"wire_bytes\":%llu,"
+             "\"compressed\":%d,\"stream_errors\":%llu,\"cpu_us\":%llu,\"inflate_us\":%llu,"
+             "\"malformed\":%llu,\"normalized\":%llu,\"gps_attached\":%llu,\"gps_sentences\":%llu,\"gps_bad_sentences\":%llu,\"oversize_drops\":%llu,\"reconnects\":%llu,"
+             "\"send_errors\":%llu,\"send_full\":%llu,\"send_blocked_us\":%llu,"
+             "\"queue_used\":%zu,\"queue_size\":%zu}",
+             endpoint_json,
+             (unsigned long long) cap->stats.frames,
+             (unsigned long long) cap->stats.bytes,
+             (unsigned long long) cap->stream.wire_bytes,
+             cap->stream.mode == CELL_STREAM_ZSTD,
+             (unsigned long long) cap->stream.errors,
+             (unsigned long long) cpu_us,
+             (unsigned long long) cap->stream.inflate_us,
+             (unsigned long long) cap->stats.malformed,
+             (unsigned long long) cap->stats.normalized,
+             (unsigned long long) cap->stats.gps_attached,
+             (unsigned long long) cap->gps.sentences,
+             (unsigned long long) cap->gps.bad_sentences,
+             (unsigned long long) cap->stats.oversize_drops,
+             (unsigned long long) cap->stats.reconnects,
+             (unsigned long long) cap->stats.send_errors,
+             (unsigned long long) cap->stats.send_full,
+             (unsigned long long) cap->stats.send_blocked_us,
+             queue_used, queue_size);
+
+    gettimeofday(&tv, NULL);
+    cap->stats.last_sent = tv.tv_sec;
+    send_blocking(caph, cap, tv, NULL, "cellstats", json, NULL);
+}
+
+static void fill_gps(struct cf_params_gps *gps, const cell_gps_fix_t *fix,
+                     const struct timeval *tv) {
+    memset(gps, 0, sizeof(*gps));
+    gps->lat = fix->lat;
+    gps->lon = fix->lon;
+    gps->alt = fix->alt;
+    gps->fix = fix->has_alt ? 3 : 2;
+    gps->speed = fix->speed;
+    gps->heading = fix->heading;
+    /* HDOP to a rough horizontal error, the inverse of what the phone did */
+    gps->precision = fix->hdop > 0 ? fix->hdop * 5.0 : 0;
+    gps->ts_sec = tv->tv_sec;
+    gps->ts_usec = tv->tv_usec;
+    gps->gps_type = "nmea";
+    gps->gps_name = "phone-nmea";
+}
+
+/* Read the phone NMEA feed into the fix ring */
+static void *gps_thread(void *aux) {
+    kis_capture_handler_t *caph = (kis_capture_handler_t *) aux;
+    cell_cap_t *cap = (cell_cap_t *) caph->userdata;
+    char buf[1024];
+    size_t nbuf = 0;
+
+    while (cap->running) {
+        if (cap->gps_sockfd < 0) {
+            cap->gps_sockfd = connect_socket(cap->gps_host, cap->gps_port);
+            if (cap->gps_sockfd < 0) {
+                sleep(1);
+                continue;
+            }
+            nbuf = 0;
+        }
+
+        struct pollfd pfd = { .fd = cap->gps_sockfd, .events = POLLIN };
+        int pr = poll(&pfd, 1, 1000);
+        if (pr <= 0) {
+            if (pr < 0 && errno != EINTR) {
+                close(cap->gps_sockfd);
+                cap->gps_sockfd = -1;
+                sleep(1);
+            }
+            continue;
+        }
+
+        ssize_t n = read(cap->gps_sockfd, buf + nbuf, sizeof(buf) - nbuf - 1);
+        if (n <= 0) {
+            close(cap->gps_sockfd);
+            cap->gps_sockfd = -1;
+            sleep(1);
+            continue;
+        }
+        nbuf += n;
+
+        size_t start = 0;
+        for (size_t i = 0; i < nbuf; i++) {
+            if (buf[i] == '\n') {
+                buf[i] = '\0';
+                cell_gps_feed_nmea(&cap->gps, buf + start, time(NULL));
+                start = i + 1;
+            }
+        }
+        if (start > 0) {
+            memmove(buf, buf + start, nbuf - start);
+            nbuf -= start;
+        }
+        if (nbuf >= sizeof(buf) - 1)
+            nbuf = 0;
+    }
+
+    return NULL;
+}
+
 static void *reader_thread(void *aux) {
     kis_capture_handler_t *caph = (kis_capture_handler_t *) aux;
     cell_cap_t *cap = (cell_cap_t *) caph->userdata;
     char buf[8192];
     size_t nbuf = 0;
+    int connected_once = 0;
     while (cap->running) {
+        if (time(NULL) - cap->stats.last_sent >= STATS_INTERVAL_SEC)
+            send_stats(caph, cap);
+
         if (cap->sockfd < 0) {
-            cap->sockfd = connect_socket(cap->host, cap->port);
+            cap->sockfd = connect_stream(cap);
             if (cap->sockfd < 0) {
                 sleep(1);
                 continue;
             }
+            if (connected_once)
+                cap->stats.reconnects++;
+            connected_once = 1;
             nbuf = 0;
+            if (cell_stream_connected(&cap->stream, cap->sockfd) < 0) {
+                close(cap->sockfd);
+                cap->sockfd = -1;
+                sleep(1);
+                continue;
+            }
         }
 
-        ssize_t n = read(cap->sockfd, buf + nbuf, sizeof(buf) - nbuf);
-        if (n <= 0) {
+        /* Decoded output may be waiting without the socket being readable */
+        if (!cell_stream_pending(&cap->stream)) {
+            /* Wake up periodically so stats still flow on an idle stream */
+            struct pollfd pfd = { .fd = cap->sockfd, .events = POLLIN };
+            int pr = poll(&pfd, 1, 1000);
+            if (pr < 0 && errno != EINTR) {
+                close(cap->sockfd);
+                cap->sockfd = -1;
+                sleep(1);
+                continue;
+            }
+            if (pr <= 0)
+                continue;
+        }
+
+        ssize_t n = cell_stream_read(&cap->stream, cap->sockfd, buf + nbuf, sizeof(buf) - nbuf);
+        if (n < 0) {
+            if (cap->stream.error != NULL)
+                fprintf(stderr, "cell: dropping stream from %s: %s\n",
+                        cap->uds_path ? cap->uds_path : cap->host, cap->stream.error);
             close(cap->sockfd);
             cap->sockfd = -1;
             sleep(1);
             continue;
         }
+        if (n == 0)
+            continue;
+        cap->stats.bytes += n;
         nbuf += n;
         size_t start = 0;
         for (size_t i = 0; i < nbuf; i++) {
@@ -151,14 +505,38 @@ static void *reader_thread(void *aux) {
                     char *line = (char *) malloc(len + 1);
                     memcpy(line, buf + start, len);
                     line[len] = '\0';
-                    cf_send_json(caph,
-                                 NULL, /* message */
-                                 0,    /* msg_type */
-                                 NULL, /* signal */
-                                 NULL, /* gps */
-                                 tv,
-                                 "cell",
-                                 line);
+                    cap->stats.frames++;
+                    if (line[0] != '{') {
+                        cap->stats.malformed++;
+                    } else {
+                        cell_record_t rec;
+                        double ts = -1;
+                        int nr = 0;
+
+                        /* Lines that don't fit the fixed record go as JSON */
+                        if (cap->normalize)
+                            nr = cell_normalize_json(line, len, &rec, &ts);
+                        else if (cap->gps_port > 0 && cell_json_ts(line, len, &ts) < 0)
+                            nr = -1;
+
+                        struct cf_params_gps gps, *gpsp = NULL;
+                        cell_gps_fix_t fix;
+                        if (nr >= 0 && cap->gps_port > 0 &&
+                                cell_gps_position(&cap->gps, ts, GPS_MAX_EXTRAP_SEC, tv.tv_sec, &fix)) {
+                            fill_gps(&gps, &fix, &tv);
+                            gpsp = &gps;
+                            cap->stats.gps_attached++;
+                        }
+
+                        if (nr < 0) {
+                            cap->stats.malformed++;
+                        } else if (nr > 0) {
+                            cap->stats.normalized++;
+                            send_blocking(caph, cap, tv, gpsp, NULL, NULL, &rec);
+                        } else {
+                            send_blocking(caph, cap, tv, gpsp, "cell", line, NULL);
+                        }
+                    }
                     free(line);
                 }
                 start = i + 1;
@@ -169,6 +547,7 @@ static void *reader_thread(void *aux) {
             nbuf -= start;
         }
         if (nbuf == sizeof(buf)) {
+            cap->stats.oversize_drops++;
             nbuf = 0; /* drop overlong line */
         }
     }
@@ -199,13 +578,15 @@ static int probe_cb(kis_capture_handler_t *caph, uint32_t seqno, char *definitio
                     char *msg, char **uuid, cf_params_interface_t **ret_interface,
                     cf_params_spectrum_t **ret_spectrum) {
     char *host = NULL;
+    char *uds = NULL;
     int port = 0;
     char uuid_buf[37];
 
-    parse_definition_endpoint(definition, &host, &port);
-    make_source_uuid(host, port, uuid_buf);
+    parse_definition_endpoint(definition, &host, &port, &uds);
+    make_source_uuid(uds ? uds : host, uds ? 0 : port, uuid_buf);
     *uuid = strdup(uuid_buf);
     free(host);
+    free(uds);
 
     *ret_interface = cf_params_interface_new();
     (*ret_interface)->capif = strdup("cell");
@@ -222,13 +603,58 @@ static int open_cb(kis_capture_handler_t *caph, uint32_t seqno, char *definition
                    cf_params_interface_t **ret_interface, cf_params_spectrum_t **ret_spectrum) {
     cell_cap_t *cap = (cell_cap_t *) caph->userdata;
     char *parsed_host = NULL;
+    char *parsed_uds = NULL;
     int parsed_port = 0;
     char uuid_buf[37];
 
-    parse_definition_endpoint(definition, &parsed_host, &parsed_port);
+    parse_definition_endpoint(definition, &parsed_host, &parsed_port, &parsed_uds);
     free(cap->host);
     cap->host = parsed_host;
     cap->port = parsed_port;
+    free(cap->uds_path);
+    cap->uds_path = parsed_uds;
+
+    char *flag = NULL;
+    int flag_len = cf_find_flag(&flag, "normalize", definition);
+    if (flag_len > 0)
+        cap->normalize = (strncasecmp(flag, "true", flag_len) == 0 || strncmp(flag, "1", flag_len) == 0);
+
+    /* gps=<port> or gps=<host>:<port>; host defaults to the stream host */
+    flag_len = cf_find_flag(&flag, "gps", definition);
+    if (flag_len > 0) {
+        char *val = strndup(flag, flag_len);
+        char *colon = strrchr(val, ':');
+        free(cap->gps_host);
+        cap->gps_host = colon ? strndup(val, (size_t) (colon - val)) : strdup(cap->host);
+        cap->gps_port = atoi(colon ? colon + 1 : val);
+        free(val);
+    }
+
+    /* compress=zstd asks the phone for a compressed stream; zdict=<path>
+     * names the shared dictionary.  Plain JSON is still accepted. */
+    int request_zstd = 0;
+    flag_len = cf_find_flag(&flag, "compress", definition);
+    if (flag_len > 0) {
+        request_zstd = strncasecmp(flag, "zstd", flag_len) == 0;
+        if (request_zstd && !cell_stream_zstd_available()) {
+            snprintf(msg, STATUS_MAX, "compress=zstd requested but this helper was built without zstd");
+            return -1;
+        }
+    }
+
+    char *zdict = NULL;
+    flag_len = cf_find_flag(&flag, "zdict", definition);
+    if (flag_len > 0)
+        zdict = strndup(flag, flag_len);
+
+    char stream_err[STATUS_MAX];
+    cell_stream_free(&cap->stream);
+    int sr = cell_stream_init(&cap->stream, request_zstd, zdict, stream_err, sizeof(stream_err));
+    free(zdict);
+    if (sr < 0) {
+        snprintf(msg, STATUS_MAX, "%s", stream_err);
+        return -1;
+    }
 
     cap->sockfd = -1;
     cap->running = 1;
@@ -238,7 +664,18 @@ static int open_cb(kis_capture_handler_t *caph, uint32_t seqno, char *definition
         return -1;
     }
 
-    make_source_uuid(cap->host, cap->port, uuid_buf);
+    if (cap->gps_port > 0) {
+        cap->gps_sockfd = -1;
+        if (pthread_create(&cap->gps_thread, NULL, gps_thread, caph) != 0) {
+            snprintf(msg, STATUS_MAX, "Failed to start GPS thread");
+            cap->gps_port = 0;
+        }
+    }
+
+    if (cap->uds_path != NULL)
+        make_source_uuid(cap->uds_path, 0, uuid_buf);
+    else
+        make_source_uuid(cap->host, cap->port, uuid_buf);
     *uuid = strdup(uuid_buf);
     *ret_interface = cf_params_interface_new();
     (*ret_interface)->capif = strdup("cell");
@@ -247,7 +684,7 @@ static int open_cb(kis_capture_handler_t *caph, uint32_t seqno, char *definition
     (*ret_interface)->channels_len = 0;
     (*ret_interface)->hardware = strdup("");
     *ret_spectrum = NULL;
-    *dlt = 0; /* unknown/raw */
+    *dlt = cap->normalize ? CELL_RECORD_DLT : 0; /* unknown/raw JSON */
     return 0;
 }
 
@@ -257,10 +694,16 @@ static void shutdown_capture(kis_capture_handler_t *caph) {
     cap->running = 0;
     if (cap->sockfd > 0) close(cap->sockfd);
     if (cap->reader_thread) pthread_join(cap->reader_thread, NULL);
+    cell_stream_free(&cap->stream);
+    if (cap->gps_port > 0 && cap->gps_thread) {
+        if (cap->gps_sockfd > 0) close(cap->gps_sockfd);
+        pthread_join(cap->gps_thread, NULL);
+    }
 }
 
 int main(int argc, char *argv[]) {
     const char *host = DEFAULT_HOST;
+    const char *uds = NULL;
     int port = DEFAULT_PORT;
 
     for (int i = 1; i < argc; i++) {
@@ -268,6 +711,8 @@ int main(int argc, char *argv[]) {
             host = argv[++i];
         } else if (!strcmp(argv[i], "--port") && i + 1 < argc) {
             port = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--uds") && i + 1 < argc) {
+            uds = argv[++i];
         } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
             usage(argv[0]);
             return 0;
@@ -277,6 +722,8 @@ int main(int argc, char *argv[]) {
     cell_cap_t cap = {0};
     cap.host = strdup(host);
     cap.port = port;
+    cap.uds_path = uds ? strdup(uds) : NULL;
+    cell_gps_init(&cap.gps);
 
     kis_capture_handler_t *caph = cf_handler_init("cell");
     if (caph == NULL) {
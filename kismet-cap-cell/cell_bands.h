@@ -0,0 +1,76 @@
+/*
+ * LTE band / EARFCN tables shared by the capture helper (C) and the Kismet
+ * plugin (C++).
+ *
+ * Frequencies follow 3GPP TS 36.101: F = F_low + 0.1 * (N - N_offs).  Bands
+ * without an uplink (SDL / TDD) have ul_low_khz = 0.
+ */
+
+#ifndef __CELL_BANDS_H__
+#define __CELL_BANDS_H__
+
+#include <stdint.h>
+
+typedef struct {
+    int band;
+    uint32_t dl_low_khz;
+    uint32_t ul_low_khz;
+    int n_offs;
+    int earfcn_lo;
+    int earfcn_hi;
+} cell_lte_band_t;
+
+static const cell_lte_band_t cell_lte_bands[] = {
+    {1, 2110000, 1920000, 0, 0, 599}, {2, 1930000, 1850000, 600, 600, 1199},
+    {3, 1805000, 1710000, 1200, 1200, 1949}, {4, 2110000, 1710000, 1950, 1950, 2399},
+    {5, 869000, 824000, 2400, 2400, 2649}, {6, 830000, 875000, 2650, 2650, 2749},
+    {7, 2620000, 2500000, 2750, 2750, 3449}, {8, 925000, 880000, 3450, 3450, 3799},
+    {9, 1844900, 1749900, 3800, 3800, 4149}, {10, 2110000, 1710000, 4150, 4150, 4749},
+    {11, 1475900, 1427900, 4750, 4750, 4949}, {12, 729000, 699000, 5010, 5010, 5179},
+    {13, 746000, 777000, 5180, 5180, 5279}, {14, 758000, 788000, 5280, 5280, 5379},
+    {17, 734000, 704000, 5035, 5730, 5849}, {18, 860000, 815000, 5850, 5850, 5999},
+    {19, 875000, 830000, 6000, 6000, 6149}, {20, 791000, 832000, 6150, 6150, 6449},
+    {21, 1495900, 1447900, 6450, 6450, 6599}, {22, 3510000, 3410000, 6600, 6600, 7399},
+    {23, 2180000, 2000000, 7500, 7500, 7699}, {24, 1525000, 1626500, 7700, 7700, 8039},
+    {25, 1930000, 1850000, 8040, 8040, 8689}, {26, 859000, 814000, 8690, 8690, 9039},
+    {27, 852000, 807000, 9040, 9040, 9209}, {28, 758000, 703000, 9210, 9210, 9659},
+    {29, 717000, 0, 9660, 9660, 9769}, {30, 2350000, 2305000, 9770, 9770, 9869},
+    {31, 462500, 452500, 9870, 9870, 9919}, {32, 1452000, 0, 9920, 9920, 10359},
+    {33, 1900000, 0, 36000, 36000, 36199}, {34, 2010000, 0, 36200, 36200, 36349},
+    {35, 1850000, 0, 36350, 36350, 36949}, {36, 1930000, 0, 36950, 36950, 37549},
+    {37, 1910000, 0, 37550, 37550, 37749}, {38, 2570000, 0, 37750, 37750, 38249},
+    {39, 1880000, 0, 38250, 38250, 38649}, {40, 2300000, 0, 38650, 38650, 39649},
+    {41, 2496000, 0, 39650, 39650, 41589}, {42, 3400000, 0, 41590, 41590, 43589},
+    {43, 3600000, 0, 43590, 43590, 45589}, {48, 3550000, 0, 55240, 55240, 56739},
+    {65, 2110000, 1920000, 65536, 65536, 66435}, {66, 2110000, 1710000, 66436, 66436, 67335},
+    {67, 738000, 0, 67336, 67336, 67535}, {68, 753000, 698000, 68336, 68336, 68585},
+    {71, 617000, 663000, 13470, 13470, 13719},
+};
+
+#define CELL_LTE_NUM_BANDS (sizeof(cell_lte_bands) / sizeof(cell_lte_bands[0]))
+
+/* Band containing an EARFCN, or 0 */
+static inline int cell_lte_band_for_earfcn(int earfcn) {
+    for (unsigned int i = 0; i < CELL_LTE_NUM_BANDS; i++) {
+        if (earfcn >= cell_lte_bands[i].earfcn_lo && earfcn <= cell_lte_bands[i].earfcn_hi)
+            return cell_lte_bands[i].band;
+    }
+    return 0;
+}
+
+/* DL/UL centre frequency of an EARFCN in a band.  Returns 0 if the band is
+ * unknown; otherwise *dl_khz is set and *ul_khz is set or 0 (no uplink). */
+static inline int cell_lte_freqs_khz(int band, int earfcn, uint32_t *dl_khz, uint32_t *ul_khz) {
+    for (unsigned int i = 0; i < CELL_LTE_NUM_BANDS; i++) {
+        const cell_lte_band_t *b = &cell_lte_bands[i];
+        if (b->band != band)
+            continue;
+        *dl_khz = (uint32_t) ((int64_t) b->dl_low_khz + 100 * ((int64_t) earfcn - b->n_offs));
+        *ul_khz = b->ul_low_khz == 0 ? 0 :
+            (uint32_t) ((int64_t) b->ul_low_khz + 100 * ((int64_t) earfcn - b->n_offs));
+        return 1;
+    }
+    return 0;
+}
+
+#endif
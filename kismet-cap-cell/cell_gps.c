@@ -0,0 +1,227 @@
+/*
+ * Phone GPS ring for the capture helper; see cell_gps.h
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell_gps.h"
+
+#define NMEA_MAX_FIELDS 20
+#define KNOTS_TO_MPS 0.514444
+#define M_PER_DEG_LAT 111320.0
+
+void cell_gps_init(cell_gps_t *gps) {
+    memset(gps, 0, sizeof(*gps));
+    pthread_mutex_init(&gps->lock, NULL);
+}
+
+static int nmea_checksum_ok(const char *s, size_t len) {
+    const char *star = memchr(s, '*', len);
+    unsigned int sum = 0;
+    char hex[3];
+
+    /* No checksum is allowed; a wrong one is not */
+    if (star == NULL)
+        return 1;
+    if ((size_t) (star - s) + 3 > len)
+        return 0;
+
+    for (const char *p = s + 1; p < star; p++)
+        sum ^= (unsigned char) *p;
+
+    hex[0] = star[1];
+    hex[1] = star[2];
+    hex[2] = '\0';
+    return sum == strtoul(hex, NULL, 16);
+}
+
+/* ddmm.mmmm + hemisphere to signed decimal degrees */
+static int nmea_coord(const char *v, const char *hemi, double *out) {
+    if (v[0] == '\0' || hemi[0] == '\0')
+        return 0;
+    double raw = strtod(v, NULL);
+    double deg = floor(raw / 100.0);
+    *out = deg + (raw - deg * 100.0) / 60.0;
+    if (hemi[0] == 'S' || hemi[0] == 'W')
+        *out = -*out;
+    return 1;
+}
+
+static void ring_put(cell_gps_t *gps, const cell_gps_fix_t *fix) {
+    if (gps->count > 0) {
+        cell_gps_fix_t *newest = &gps->ring[(gps->head + CELL_GPS_RING - 1) % CELL_GPS_RING];
+
+        /* The phone repeats its last fix every second; refresh it in place */
+        if (fix->ts == newest->ts) {
+            *newest = *fix;
+            return;
+        }
+
+        /* Keep the ring ordered; late sentences are dropped */
+        if (fix->ts < newest->ts)
+            return;
+    }
+
+    gps->ring[gps->head] = *fix;
+    gps->head = (gps->head + 1) % CELL_GPS_RING;
+    if (gps->count < CELL_GPS_RING)
+        gps->count++;
+}
+
+int cell_gps_feed_nmea(cell_gps_t *gps, const char *line, time_t now) {
+    char buf[256];
+    char *fields[NMEA_MAX_FIELDS];
+    int nfields = 0;
+    size_t len = strlen(line);
+    int ret = 0;
+
+    while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == '\n'))
+        len--;
+    if (len < 7 || line[0] != '$' || len >= sizeof(buf))
+        return 0;
+
+    pthread_mutex_lock(&gps->lock);
+    gps->sentences++;
+
+    if (!nmea_checksum_ok(line, len)) {
+        gps->bad_sentences++;
+        pthread_mutex_unlock(&gps->lock);
+        return -1;
+    }
+
+    memcpy(buf, line, len);
+    buf[len] = '\0';
+    char *star = strchr(buf, '*');
+    if (star != NULL)
+        *star = '\0';
+
+    char *p = buf;
+    fields[nfields++] = p;
+    while ((p = strchr(p, ',')) != NULL && nfields < NMEA_MAX_FIELDS) {
+        *p++ = '\0';
+        fields[nfields++] = p;
+    }
+
+    /* Any talker ($GP, $GN, $GL...) */
+    const char *type = fields[0] + 3;
+
+    if (strcmp(type, "GGA") == 0 && nfields >= 10) {
+        if (atoi(fields[6]) > 0 && fields[1][0] != '\0') {
+            gps->gga_valid = 1;
+            gps->gga_hhmmss = atoi(fields[1]);
+            gps->gga_hdop = strtod(fields[8], NULL);
+            gps->gga_alt = strtod(fields[9], NULL);
+        } else {
+            gps->gga_valid = 0;
+        }
+    } else if (strcmp(type, "RMC") == 0 && nfields >= 10) {
+        cell_gps_fix_t fix;
+        struct tm tm;
+        memset(&fix, 0, sizeof(fix));
+        memset(&tm, 0, sizeof(tm));
+
+        if (fields[2][0] == 'A' && strlen(fields[1]) >= 6 && strlen(fields[9]) == 6 &&
+                nmea_coord(fields[3], fields[4], &fix.lat) &&
+                nmea_coord(fields[5], fields[6], &fix.lon)) {
+            double hms = strtod(fields[1], NULL);
+            int ihms = (int) hms;
+            int date = atoi(fields[9]);
+
+            tm.tm_hour = ihms / 10000;
+            tm.tm_min = (ihms / 100) % 100;
+            tm.tm_sec = ihms % 100;
+            tm.tm_mday = date / 10000;
+            tm.tm_mon = (date / 100) % 100 - 1;
+            tm.tm_year = 100 + date % 100;
+
+            fix.ts = (double) timegm(&tm) + (hms - ihms);
+            fix.speed = strtod(fields[7], NULL) * KNOTS_TO_MPS;
+            fix.heading = strtod(fields[8], NULL);
+            fix.received = now;
+
+            if (gps->gga_valid && gps->gga_hhmmss == ihms) {
+                fix.alt = gps->gga_alt;
+                fix.hdop = gps->gga_hdop;
+                fix.has_alt = 1;
+            }
+
+            ring_put(gps, &fix);
+            ret = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&gps->lock);
+    return ret;
+}
+
+int cell_gps_position(cell_gps_t *gps, double ts, double max_extrap, time_t now,
+                      cell_gps_fix_t *out) {
+    int ret = 0;
+
+    pthread_mutex_lock(&gps->lock);
+
+    if (gps->count == 0)
+        goto done;
+
+    const cell_gps_fix_t *newest = &gps->ring[(gps->head + CELL_GPS_RING - 1) % CELL_GPS_RING];
+
+    if (ts < 0) {
+        if (difftime(now, newest->received) <= max_extrap) {
+            *out = *newest;
+            ret = 1;
+        }
+        goto done;
+    }
+
+    if (ts >= newest->ts) {
+        double dt = ts - newest->ts;
+        if (dt > max_extrap)
+            goto done;
+
+        /* Dead-reckon along the last heading */
+        double d = newest->speed * dt;
+        double h = newest->heading * M_PI / 180.0;
+        *out = *newest;
+        out->ts = ts;
+        out->lat += d * cos(h) / M_PER_DEG_LAT;
+        out->lon += d * sin(h) / (M_PER_DEG_LAT * cos(newest->lat * M_PI / 180.0));
+        ret = 1;
+        goto done;
+    }
+
+    /* Walk back from the newest fix; frames are nearly always recent */
+    for (unsigned int i = 1; i < gps->count; i++) {
+        const cell_gps_fix_t *b = &gps->ring[(gps->head + CELL_GPS_RING - i) % CELL_GPS_RING];
+        const cell_gps_fix_t *a = &gps->ring[(gps->head + CELL_GPS_RING - i - 1) % CELL_GPS_RING];
+
+        if (ts < a->ts)
+            continue;
+
+        double f = (ts - a->ts) / (b->ts - a->ts);
+        double dlon = b->lon - a->lon;
+        if (dlon > 180)
+            dlon -= 360;
+        else if (dlon < -180)
+            dlon += 360;
+
+        *out = f < 0.5 ? *a : *b;
+        out->ts = ts;
+        out->lat = a->lat + f * (b->lat - a->lat);
+        out->lon = a->lon + f * dlon;
+        if (out->lon > 180)
+            out->lon -= 360;
+        else if (out->lon < -180)
+            out->lon += 360;
+        out->speed = a->speed + f * (b->speed - a->speed);
+        if (a->has_alt && b->has_alt)
+            out->alt = a->alt + f * (b->alt - a->alt);
+        ret = 1;
+        break;
+    }
+
+done:
+    pthread_mutex_unlock(&gps->lock);
+    return ret;
+}
@@ -0,0 +1,62 @@
+/*
+ * Phone GPS ring for the capture helper
+ *
+ * Fixes from the phone's NMEA feed (GGA + RMC, as produced by the Android app
+ * on port 8766) are kept in a short ring ordered by fix time.  Cell frames
+ * are then given a position interpolated to their own phone timestamp, so
+ * frames sent between 1 Hz fixes are not all placed at the last fix.
+ *
+ * Both timestamps come from the phone, so host clock skew does not matter.
+ */
+
+#ifndef __CELL_GPS_H__
+#define __CELL_GPS_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#define CELL_GPS_RING 64
+
+typedef struct {
+    double ts;          /* phone UTC, seconds */
+    double lat;
+    double lon;
+    double alt;         /* metres */
+    double speed;       /* m/s */
+    double heading;     /* degrees */
+    double hdop;
+    int has_alt;
+    time_t received;    /* host time the fix arrived */
+} cell_gps_fix_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    cell_gps_fix_t ring[CELL_GPS_RING];
+    unsigned int head;      /* next write slot */
+    unsigned int count;
+
+    /* GGA is sent before RMC for the same second; hold its alt/hdop */
+    int gga_valid;
+    int gga_hhmmss;
+    double gga_alt;
+    double gga_hdop;
+
+    uint64_t sentences;
+    uint64_t bad_sentences;
+} cell_gps_t;
+
+void cell_gps_init(cell_gps_t *gps);
+
+/* Feed one NMEA line (with or without trailing CR/LF).  Returns 1 if a fix was
+ * added or updated, 0 if the sentence was ignored, -1 if it was invalid. */
+int cell_gps_feed_nmea(cell_gps_t *gps, const char *line, time_t now);
+
+/* Position at phone time ts.  Between two fixes the position is interpolated;
+ * up to max_extrap seconds past the newest fix it is dead-reckoned from speed
+ * and heading.  With ts < 0 (frame had no timestamp) the newest fix is used if
+ * it arrived within max_extrap seconds of now.  Returns 1 if out was filled. */
+int cell_gps_position(cell_gps_t *gps, double ts, double max_extrap, time_t now,
+                      cell_gps_fix_t *out);
+
+#endif
@@ -0,0 +1,423 @@
+/*
+ * Helper-side normalization of the phone JSON; see cell_normalize.h
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cell_bands.h"
+#include "cell_normalize.h"
+
+/* Nesting limit when skipping values we don't care about */
+#define CN_MAX_DEPTH 32
+
+typedef struct {
+    const char *p;
+    size_t n;
+    /* 0 absent, 's' string, 'n' number, 't' true, 'f' false, 'z' null,
+     * 'o' object, 'a' array; for o/a the span includes the brackets */
+    char type;
+} cn_tok;
+
+enum {
+    CN_FULL_CELL_KEY, CN_FULL_CELL_ID, CN_MCC, CN_MNC, CN_TAC, CN_LAC, CN_CID,
+    CN_NRARFCN, CN_EARFCN, CN_ARFCN, CN_PCI, CN_BAND, CN_RSSI, CN_RSRP, CN_RSRQ,
+    CN_RAT, CN_REGISTERED, CN_TA,
+    CN_LAT, CN_LON, CN_ALT_M, CN_ALT, CN_SPEED_MPS, CN_BEARING_DEG, CN_ACCURACY_M, CN_ACC,
+    CN_CELLS, CN_LOCATION, CN_TS,
+    CN_NUM_FIELDS
+};
+
+static const char *cn_field_names[CN_NUM_FIELDS] = {
+    "full_cell_key", "full_cell_id", "mcc", "mnc", "tac", "lac", "cid",
+    "nrarfcn", "earfcn", "arfcn", "pci", "band", "rssi", "rsrp", "rsrq",
+    "rat", "registered", "timing_advance",
+    "lat", "lon", "alt_m", "alt", "speed_mps", "bearing_deg", "accuracy_m", "acc",
+    "cells", "location", "ts",
+};
+
+typedef struct {
+    cn_tok f[CN_NUM_FIELDS];
+} cn_obj;
+
+static const char *cn_ws(const char *p, const char *e) {
+    while (p < e && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+    return p;
+}
+
+/* p at the opening quote; returns the position after the closing quote */
+static const char *cn_string_end(const char *p, const char *e) {
+    for (p++; p < e; p++) {
+        if (*p == '\\') {
+            p++;
+            continue;
+        }
+        if (*p == '"')
+            return p + 1;
+    }
+    return NULL;
+}
+
+/* Tokenize the value at p; nested containers are skipped as a whole */
+static const char *cn_value(const char *p, const char *e, cn_tok *tok) {
+    const char *start = p;
+
+    if (p >= e)
+        return NULL;
+
+    if (*p == '"') {
+        const char *end = cn_string_end(p, e);
+        if (end == NULL)
+            return NULL;
+        tok->p = p + 1;
+        tok->n = (size_t) (end - p - 2);
+        tok->type = 's';
+        return end;
+    }
+
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        for (; p < e; p++) {
+            if (*p == '"') {
+                p = cn_string_end(p, e);
+                if (p == NULL)
+                    return NULL;
+                p--;
+            } else if (*p == '{' || *p == '[') {
+                if (++depth > CN_MAX_DEPTH)
+                    return NULL;
+            } else if (*p == '}' || *p == ']') {
+                if (--depth == 0) {
+                    tok->p = start;
+                    tok->n = (size_t) (p + 1 - start);
+                    tok->type = *start == '{' ? 'o' : 'a';
+                    return p + 1;
+                }
+            }
+        }
+        return NULL;
+    }
+
+    if (e - p >= 4 && strncmp(p, "true", 4) == 0) {
+        tok->type = 't';
+        tok->p = p;
+        tok->n = 4;
+        return p + 4;
+    }
+    if (e - p >= 5 && strncmp(p, "false", 5) == 0) {
+        tok->type = 'f';
+        tok->p = p;
+        tok->n = 5;
+        return p + 5;
+    }
+    if (e - p >= 4 && strncmp(p, "null", 4) == 0) {
+        tok->type = 'z';
+        tok->p = p;
+        tok->n = 4;
+        return p + 4;
+    }
+
+    while (p < e && (*p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E' ||
+                (*p >= '0' && *p <= '9')))
+        p++;
+    if (p == start)
+        return NULL;
+    tok->p = start;
+    tok->n = (size_t) (p - start);
+    tok->type = 'n';
+    return p;
+}
+
+/* Scan an object, recording the fields we know about.  Later duplicates win,
+ * as they would in a parsed document. */
+static int cn_scan_object(const char *p, const char *e, cn_obj *obj) {
+    memset(obj, 0, sizeof(*obj));
+
+    p = cn_ws(p, e);
+    if (p >= e || *p != '{')
+        return -1;
+    p = cn_ws(p + 1, e);
+    if (p < e && *p == '}')
+        return 0;
+
+    while (p < e) {
+        if (*p != '"')
+            return -1;
+        const char *kend = cn_string_end(p, e);
+        if (kend == NULL)
+            return -1;
+        const char *key = p + 1;
+        size_t klen = (size_t) (kend - p - 2);
+
+        p = cn_ws(kend, e);
+        if (p >= e || *p != ':')
+            return -1;
+        p = cn_ws(p + 1, e);
+
+        cn_tok tok;
+        p = cn_value(p, e, &tok);
+        if (p == NULL)
+            return -1;
+
+        for (int i = 0; i < CN_NUM_FIELDS; i++) {
+            if (strlen(cn_field_names[i]) == klen && memcmp(cn_field_names[i], key, klen) == 0) {
+                obj->f[i] = tok;
+                break;
+            }
+        }
+
+        p = cn_ws(p, e);
+        if (p < e && *p == ',') {
+            p = cn_ws(p + 1, e);
+            continue;
+        }
+        if (p < e && *p == '}')
+            return 0;
+        return -1;
+    }
+
+    return -1;
+}
+
+/* Copy a token the way the PHY's to_string would render it.  Returns 0 if it
+ * does not fit. */
+static int cn_str(const cn_tok *t, char *out, size_t sz) {
+    size_t n = 0;
+    const char *src = "";
+
+    switch (t->type) {
+        case 's':
+        case 'n':
+        case 'o':
+        case 'a':
+            src = t->p;
+            n = t->n;
+            break;
+        case 't':
+            src = "true";
+            n = 4;
+            break;
+        case 'f':
+            src = "false";
+            n = 5;
+            break;
+        default:
+            break;
+    }
+
+    if (n >= sz)
+        return 0;
+    memcpy(out, src, n);
+    out[n] = '\0';
+    return 1;
+}
+
+/* Integer from an integral number or a numeric string, like the PHY's to_int */
+static int cn_int(const cn_tok *t, int *out) {
+    char buf[32];
+    char *end;
+    long v;
+
+    if (t->type != 'n' && t->type != 's')
+        return 0;
+    if (t->n == 0 || t->n >= sizeof(buf))
+        return 0;
+    memcpy(buf, t->p, t->n);
+    buf[t->n] = '\0';
+
+    if (t->type == 'n' && strpbrk(buf, ".eE") != NULL)
+        return 0;
+
+    v = strtol(buf, &end, 10);
+    if (end == buf)
+        return 0;
+    *out = (int) v;
+    return 1;
+}
+
+static int cn_double(const cn_tok *t, double *out) {
+    char buf[48];
+
+    if (t->type != 'n' || t->n >= sizeof(buf))
+        return 0;
+    memcpy(buf, t->p, t->n);
+    buf[t->n] = '\0';
+    *out = strtod(buf, NULL);
+    return 1;
+}
+
+/* Signal values: any number, truncated; out of int16 range (Android's
+ * UNAVAILABLE is INT_MAX) counts as absent.  The PHY's JSON path applies the
+ * same rule, so the rssi -> rsrp fallback agrees between the two. */
+static int16_t cn_signal(const cn_tok *t) {
+    double d;
+    if (!cn_double(t, &d) || !(d > -32768 && d < 32768))
+        return 0;
+    return (int16_t) d;
+}
+
+int cell_json_ts(const char *json, size_t len, double *ts) {
+    cn_obj top;
+
+    if (cn_scan_object(json, json + len, &top) < 0)
+        return -1;
+    return cn_double(&top.f[CN_TS], ts);
+}
+
+int cell_normalize_json(const char *json, size_t len, cell_record_t *rec, double *ts) {
+    const char *e = json + len;
+    cn_obj top, cell, loc;
+    const cn_obj *c = &top;
+    int found = 0;
+
+    if (cn_scan_object(json, e, &top) < 0)
+        return -1;
+
+    if (ts != NULL && !cn_double(&top.f[CN_TS], ts))
+        *ts = -1;
+
+    /* Primary cell: first registered=true, else first entry */
+    if (top.f[CN_CELLS].type == 'a') {
+        const char *p = cn_ws(top.f[CN_CELLS].p + 1, e);
+        const char *ae = top.f[CN_CELLS].p + top.f[CN_CELLS].n - 1;
+
+        while (p < ae) {
+            cn_tok el;
+            const char *next = cn_value(p, ae, &el);
+            if (next == NULL)
+                return -1;
+
+            if (el.type == 'o') {
+                cn_obj tmp;
+                if (cn_scan_object(el.p, el.p + el.n, &tmp) < 0)
+                    return -1;
+                if (!found || tmp.f[CN_REGISTERED].type == 't') {
+                    int reg = tmp.f[CN_REGISTERED].type == 't';
+                    cell = tmp;
+                    found = 1;
+                    if (reg)
+                        break;
+                }
+            }
+
+            p = cn_ws(next, ae);
+            if (p < ae && *p == ',')
+                p = cn_ws(p + 1, ae);
+        }
+
+        if (found)
+            c = &cell;
+    }
+
+    memset(rec, 0, sizeof(*rec));
+
+    /* Identity */
+    if (!cn_str(&c->f[CN_RAT], rec->rat, sizeof(rec->rat)) ||
+            !cn_str(&c->f[CN_MCC], rec->mcc, sizeof(rec->mcc)) ||
+            !cn_str(&c->f[CN_MNC], rec->mnc, sizeof(rec->mnc)) ||
+            !cn_str(c->f[CN_TAC].type ? &c->f[CN_TAC] : &c->f[CN_LAC], rec->tac, sizeof(rec->tac)) ||
+            !cn_str(c->f[CN_FULL_CELL_ID].type ? &c->f[CN_FULL_CELL_ID] : &c->f[CN_CID],
+                rec->cid, sizeof(rec->cid)))
+        return 0;
+
+    if ((size_t) snprintf(rec->composite, sizeof(rec->composite), "%s%s-%s-%s",
+                rec->mcc, rec->mnc, rec->tac, rec->cid) >= sizeof(rec->composite))
+        return 0;
+
+    if (!cn_str(&c->f[CN_FULL_CELL_KEY], rec->fullid, sizeof(rec->fullid)))
+        return 0;
+    if (rec->fullid[0] == '\0' &&
+            !cn_str(&c->f[CN_FULL_CELL_ID], rec->fullid, sizeof(rec->fullid)))
+        return 0;
+    if (rec->fullid[0] == '\0')
+        memcpy(rec->fullid, rec->composite, sizeof(rec->fullid));
+
+    uint32_t flags = 0;
+    int v;
+
+    if (c->f[CN_REGISTERED].type == 't')
+        flags |= CELL_REC_REGISTERED;
+
+    /* Channel: first of nrarfcn/earfcn/arfcn that holds an integer */
+    if (cn_int(&c->f[CN_NRARFCN], &v) || cn_int(&c->f[CN_EARFCN], &v) ||
+            cn_int(&c->f[CN_ARFCN], &v)) {
+        flags |= CELL_REC_HAS_ARFCN;
+        rec->arfcn = (int32_t) htole32((uint32_t) v);
+
+        int band = 0;
+        if (cn_int(&c->f[CN_BAND], &band) || (band = cell_lte_band_for_earfcn(v)) != 0) {
+            uint32_t dl, ul;
+            flags |= CELL_REC_HAS_BAND;
+            rec->band = (int32_t) htole32((uint32_t) band);
+            if (cell_lte_freqs_khz(band, v, &dl, &ul)) {
+                flags |= CELL_REC_HAS_DL_FREQ;
+                rec->dl_freq_khz = htole32(dl);
+                if (ul != 0) {
+                    flags |= CELL_REC_HAS_UL_FREQ;
+                    rec->ul_freq_khz = htole32(ul);
+                }
+            }
+        }
+    } else if (cn_int(&c->f[CN_BAND], &v)) {
+        flags |= CELL_REC_HAS_BAND;
+        rec->band = (int32_t) htole32((uint32_t) v);
+    }
+
+    if (cn_int(&c->f[CN_PCI], &v)) {
+        flags |= CELL_REC_HAS_PCI;
+        rec->pci = (int32_t) htole32((uint32_t) v);
+    }
+
+    if (cn_int(&c->f[CN_TA], &v)) {
+        flags |= CELL_REC_HAS_TA;
+        rec->timing_advance = (int32_t) htole32((uint32_t) v);
+    }
+
+    int16_t rssi = cn_signal(&c->f[CN_RSSI]);
+    int16_t rsrp = cn_signal(&c->f[CN_RSRP]);
+    if (rssi == 0 && rsrp != 0)
+        rssi = rsrp;
+    rec->rssi = (int16_t) htole16((uint16_t) rssi);
+    rec->rsrp = (int16_t) htole16((uint16_t) rsrp);
+    rec->rsrq = (int16_t) htole16((uint16_t) cn_signal(&c->f[CN_RSRQ]));
+
+    /* Phone position: flat (Android app) or nested location (SCHEMA.md) */
+    const cn_obj *pos = NULL;
+    if (top.f[CN_LAT].type) {
+        pos = &top;
+    } else if (top.f[CN_LOCATION].type == 'o' &&
+            cn_scan_object(top.f[CN_LOCATION].p, top.f[CN_LOCATION].p + top.f[CN_LOCATION].n,
+                &loc) == 0) {
+        pos = &loc;
+    }
+
+    double lat, lon, d;
+    /* Out of range would wrap in the fixed-point fields, maybe onto a real
+     * place; the other position fields are bounded the same way */
+    if (pos != NULL && cn_double(&pos->f[CN_LAT], &lat) && cn_double(&pos->f[CN_LON], &lon) &&
+            !(lat == 0 && lon == 0) && lat >= -90 && lat <= 90 && lon >= -180 && lon <= 180) {
+        flags |= CELL_REC_HAS_LOCATION;
+        rec->lat_e7 = (int32_t) htole32((uint32_t) (int32_t) lround(lat * 1e7));
+        rec->lon_e7 = (int32_t) htole32((uint32_t) (int32_t) lround(lon * 1e7));
+        if ((cn_double(&pos->f[CN_ALT_M], &d) || cn_double(&pos->f[CN_ALT], &d)) &&
+                d > -2e7 && d < 2e7)
+            rec->alt_cm = (int32_t) htole32((uint32_t) (int32_t) lround(d * 100));
+        if (cn_double(&pos->f[CN_SPEED_MPS], &d) && d > 0 && d < 4e7)
+            rec->speed_cmps = htole32((uint32_t) lround(d * 100));
+        if (cn_double(&pos->f[CN_BEARING_DEG], &d) && d > 0 && d <= 360)
+            rec->heading_cdeg = htole32((uint32_t) lround(d * 100));
+        if ((cn_double(&pos->f[CN_ACCURACY_M], &d) || cn_double(&pos->f[CN_ACC], &d)) &&
+                d > 0 && d < 4e7)
+            rec->accuracy_cm = htole32((uint32_t) lround(d * 100));
+    }
+
+    rec->magic = htole32(CELL_RECORD_MAGIC);
+    rec->version = htole16(CELL_RECORD_VERSION);
+    rec->length = htole16(sizeof(cell_record_t));
+    rec->flags = htole32(flags);
+
+    return 1;
+}
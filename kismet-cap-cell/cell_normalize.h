@@ -0,0 +1,32 @@
+/*
+ * Helper-side normalization of the phone JSON into a cell_record_t
+ *
+ * A small allocation-free scanner that only understands as much JSON as the
+ * phone feed needs: the top-level object, the cells[] array and the optional
+ * location object.  Field selection and fallbacks follow the PHY JSON path so
+ * both modes produce the same devices.
+ */
+
+#ifndef __CELL_NORMALIZE_H__
+#define __CELL_NORMALIZE_H__
+
+#include <stddef.h>
+
+#include "cell_record.h"
+
+/* Normalize one JSON line.  If ts is not NULL it receives the frame's phone
+ * timestamp, or -1 if there is none.
+ *
+ * Returns:
+ * -1   Malformed JSON
+ *  0   Valid JSON that can't be expressed as a record (no identity, or a
+ *      field too long for the fixed layout); send it as JSON instead
+ *  1   Record filled in, little-endian, ready to send
+ */
+int cell_normalize_json(const char *json, size_t len, cell_record_t *rec, double *ts);
+
+/* Just the top-level phone timestamp.  Returns 1 if found, 0 if absent, -1 on
+ * malformed JSON. */
+int cell_json_ts(const char *json, size_t len, double *ts);
+
+#endif
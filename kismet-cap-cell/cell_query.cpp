@@ -0,0 +1,914 @@
+/*
+ * cell_query - one-pass query tool over archived cell JSONL captures
+ *
+ * Memory-maps one or more JSONL archives (as written by collector.py --jsonl),
+ * splits each mapping on newline boundaries across worker threads and answers
+ * the common post-drive questions in a single pass:
+ *
+ *   plmn   distinct cells + observations per PLMN / RAT / band
+ *   cells  per-cell best/worst signal, observation count, first/last seen
+ *   obs    individual observations (usually combined with --bbox)
+ *
+ * Output is CSV (default) or JSON.  Archives are mapped read-only and pages
+ * behind each worker are released as it goes, so inputs larger than RAM are
+ * fine.  obs rows are spilled to one unlinked temporary file per worker in
+ * $TMPDIR (default /var/tmp, which is normally disk rather than tmpfs) and
+ * copied out in input order at the end.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Target chunk size; small enough to load-balance, big enough to amortize setup
+constexpr std::size_t kChunkSize = 32 * 1024 * 1024;
+// Pages are dropped from our mapping once a worker is this far past them;
+// must stay well under kChunkSize or no chunk ever gets that far
+constexpr std::size_t kReleaseWindow = kChunkSize / 4;
+static_assert(kReleaseWindow < kChunkSize, "release window never reached within a chunk");
+
+struct Args {
+    std::vector<std::string> files;
+    bool want_plmn = false;
+    bool want_cells = false;
+    bool want_obs = false;
+    bool json = false;
+    bool have_bbox = false;
+    double min_lat = 0, min_lon = 0, max_lat = 0, max_lon = 0;
+    unsigned int threads = 0;
+    std::string output;
+};
+
+void usage(const char* prog) {
+    std::cerr << "Usage: " << prog
+              << " [--query plmn|cells|obs]... [--bbox MINLAT,MINLON,MAXLAT,MAXLON]\n"
+              << "       [--format csv|json] [--threads N] [--output FILE] FILE.jsonl...\n"
+              << "\n"
+              << "Queries may be repeated (or comma-separated); all requested queries are\n"
+              << "answered from one pass over the input.  --bbox restricts every query to\n"
+              << "observations inside the box.  Default query is 'cells'.  obs rows are\n"
+              << "staged in $TMPDIR (default /var/tmp).\n";
+}
+
+bool parse_bbox(const std::string& s, Args& args) {
+    double v[4];
+    const char* p = s.c_str();
+    for (int i = 0; i < 4; i++) {
+        char* end = nullptr;
+        v[i] = std::strtod(p, &end);
+        if (end == p)
+            return false;
+        p = end;
+        if (i < 3) {
+            if (*p != ',')
+                return false;
+            p++;
+        }
+    }
+    args.min_lat = std::min(v[0], v[2]);
+    args.max_lat = std::max(v[0], v[2]);
+    args.min_lon = std::min(v[1], v[3]);
+    args.max_lon = std::max(v[1], v[3]);
+    args.have_bbox = true;
+    return true;
+}
+
+Args parse_args(int argc, char* argv[]) {
+    Args args;
+    for (int i = 1; i < argc; ++i) {
+        std::string a(argv[i]);
+        if (a == "--query" && i + 1 < argc) {
+            std::string q(argv[++i]);
+            std::size_t start = 0;
+            while (start <= q.size()) {
+                auto comma = q.find(',', start);
+                auto tok = q.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+                if (tok == "plmn") {
+                    args.want_plmn = true;
+                } else if (tok == "cells") {
+                    args.want_cells = true;
+                } else if (tok == "obs") {
+                    args.want_obs = true;
+                } else {
+                    std::cerr << "Unknown query: " << tok << "\n";
+                    std::exit(1);
+                }
+                if (comma == std::string::npos)
+                    break;
+                start = comma + 1;
+            }
+        } else if (a == "--bbox" && i + 1 < argc) {
+            if (!parse_bbox(argv[++i], args)) {
+                std::cerr << "Invalid --bbox, expected MINLAT,MINLON,MAXLAT,MAXLON\n";
+                std::exit(1);
+            }
+        } else if (a == "--format" && i + 1 < argc) {
+            std::string f(argv[++i]);
+            if (f == "json") {
+                args.json = true;
+            } else if (f != "csv") {
+                std::cerr << "Unknown format: " << f << "\n";
+                std::exit(1);
+            }
+        } else if (a == "--threads" && i + 1 < argc) {
+            std::string_view n(argv[++i]);
+            auto r = std::from_chars(n.data(), n.data() + n.size(), args.threads);
+            if (r.ec != std::errc() || r.ptr != n.data() + n.size()) {
+                std::cerr << "Invalid --threads: " << n << "\n";
+                usage(argv[0]);
+                std::exit(1);
+            }
+        } else if (a == "--output" && i + 1 < argc) {
+            args.output = argv[++i];
+        } else if (a == "-h" || a == "--help") {
+            usage(argv[0]);
+            std::exit(0);
+        } else if (!a.empty() && a[0] == '-') {
+            usage(argv[0]);
+            std::exit(1);
+        } else {
+            args.files.push_back(a);
+        }
+    }
+    if (!args.want_plmn && !args.want_cells && !args.want_obs)
+        args.want_cells = true;
+    if (args.threads == 0)
+        args.threads = std::max(1u, std::thread::hardware_concurrency());
+    return args;
+}
+
+/*
+ * Minimal flat-object JSON field extractor.  Collector records are flat objects
+ * whose values are strings, numbers, booleans or null (neighbors is a JSON
+ * encoded string), so we only need to walk top-level key/value pairs and hand
+ * back raw value slices; nested values are skipped without being decoded.
+ */
+struct json_field {
+    std::string_view key;
+    std::string_view value;   // raw slice; strings have their quotes stripped
+    bool is_string = false;
+    bool is_null = false;
+};
+
+class flat_json_reader {
+public:
+    flat_json_reader(const char* b, const char* e) : p(b), end(e) {
+        skip_ws();
+        if (p < end && *p == '{')
+            p++;
+        else
+            p = end;
+    }
+
+    bool next(json_field& out) {
+        skip_ws();
+        if (p < end && *p == ',') {
+            p++;
+            skip_ws();
+        }
+        if (p >= end || *p != '"')
+            return false;
+        out.key = read_string();
+        skip_ws();
+        if (p >= end || *p != ':')
+            return false;
+        p++;
+        skip_ws();
+        if (p >= end)
+            return false;
+
+        out.is_string = false;
+        out.is_null = false;
+        if (*p == '"') {
+            out.is_string = true;
+            out.value = read_string();
+        } else if (*p == '{' || *p == '[') {
+            const char* s = p;
+            skip_nested();
+            out.value = std::string_view(s, static_cast<std::size_t>(p - s));
+        } else {
+            const char* s = p;
+            while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r')
+                p++;
+            out.value = std::string_view(s, static_cast<std::size_t>(p - s));
+            out.is_null = out.value == "null";
+        }
+        return true;
+    }
+
+private:
+    void skip_ws() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+    }
+
+    // Returns the raw (still escaped) body; none of the keys we match need unescaping
+    std::string_view read_string() {
+        const char* s = ++p;
+        while (p < end && *p != '"') {
+            if (*p == '\\')
+                p++;
+            p++;
+        }
+        std::string_view r(s, static_cast<std::size_t>(std::min(p, end) - s));
+        if (p < end)
+            p++;
+        return r;
+    }
+
+    void skip_nested() {
+        int depth = 0;
+        while (p < end) {
+            char c = *p;
+            if (c == '"') {
+                read_string();
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    p++;
+                    return;
+                }
+            }
+            p++;
+        }
+    }
+
+    const char* p;
+    const char* end;
+};
+
+bool to_double(const json_field& f, double& out) {
+    if (f.is_null || f.value.empty())
+        return false;
+    auto r = std::from_chars(f.value.data(), f.value.data() + f.value.size(), out);
+    return r.ec == std::errc() && std::isfinite(out);
+}
+
+// Android reports unavailable measurements as INT_MAX / CellInfo.UNAVAILABLE
+bool to_signal(const json_field& f, int& out) {
+    double d;
+    if (!to_double(f, d))
+        return false;
+    if (d >= 0 || d < -200)
+        return false;
+    out = static_cast<int>(d);
+    return true;
+}
+
+struct observation {
+    std::string_view device_id;
+    std::string_view key;
+    std::string_view mcc, mnc, rat, band;
+    std::string_view tac, cid;
+    double ts = 0;
+    double lat = 0, lon = 0;
+    bool has_ts = false, has_pos = false;
+    int rsrp = 0, rssi = 0;
+    bool has_rsrp = false, has_rssi = false;
+};
+
+struct cell_agg {
+    std::string plmn, rat, band;
+    uint64_t observations = 0;
+    int best = std::numeric_limits<int>::min();
+    int worst = std::numeric_limits<int>::max();
+    double first_seen = std::numeric_limits<double>::max();
+    double last_seen = std::numeric_limits<double>::lowest();
+
+    void merge(const cell_agg& o) {
+        if (plmn.empty()) plmn = o.plmn;
+        if (rat.empty()) rat = o.rat;
+        if (band.empty()) band = o.band;
+        observations += o.observations;
+        best = std::max(best, o.best);
+        worst = std::min(worst, o.worst);
+        first_seen = std::min(first_seen, o.first_seen);
+        last_seen = std::max(last_seen, o.last_seen);
+    }
+};
+
+struct plmn_agg {
+    uint64_t distinct_cells = 0;
+    uint64_t observations = 0;
+};
+
+struct chunk {
+    const char* begin;
+    const char* end;
+    const char* map_base;
+    // Where this chunk's obs rows sit in its worker's spill file, so the
+    // output can follow input order whichever worker took the chunk
+    FILE* obs_out = nullptr;
+    long obs_off = 0;
+    long obs_len = 0;
+};
+
+struct worker_state {
+    std::unordered_map<std::string, cell_agg> cells;
+    uint64_t lines = 0;
+    uint64_t bad_lines = 0;
+    uint64_t no_cell_lines = 0;
+    FILE* obs_spill = nullptr;
+};
+
+bool parse_line(const char* b, const char* e, observation& o) {
+    flat_json_reader rd(b, e);
+    json_field f;
+    bool any = false;
+    while (rd.next(f)) {
+        any = true;
+        const auto& k = f.key;
+        if (k == "full_cell_key") {
+            o.key = f.value;
+        } else if (k == "device_id") {
+            o.device_id = f.value;
+        } else if (k == "mcc") {
+            if (!f.is_null) o.mcc = f.value;
+        } else if (k == "mnc") {
+            if (!f.is_null) o.mnc = f.value;
+        } else if (k == "rat") {
+            if (!f.is_null) o.rat = f.value;
+        } else if (k == "band") {
+            if (!f.is_null) o.band = f.value;
+        } else if (k == "ts") {
+            o.has_ts = to_double(f, o.ts);
+        } else if (k == "lat") {
+            o.has_pos = to_double(f, o.lat);
+        } else if (k == "lon") {
+            o.has_pos = to_double(f, o.lon) && o.has_pos;
+        } else if (k == "rsrp") {
+            o.has_rsrp = to_signal(f, o.rsrp);
+        } else if (k == "rssi") {
+            o.has_rssi = to_signal(f, o.rssi);
+        } else if (k == "full_cell_id" || (k == "cid" && o.cid.empty())) {
+            if (!f.is_null) o.cid = f.value;
+        } else if (k == "tac" || (k == "lac" && o.tac.empty())) {
+            if (!f.is_null) o.tac = f.value;
+        }
+    }
+    if (!any)
+        return false;
+    // Pre-key archives: nothing to group by unless we have a CID
+    if (o.key.empty() && o.cid.empty())
+        return false;
+    return true;
+}
+
+// Decode a raw JSON string body, as the reader hands it out, onto out
+void append_unescaped(std::string& out, std::string_view raw) {
+    if (raw.find('\\') == std::string_view::npos) {
+        out.append(raw);
+        return;
+    }
+
+    auto hex4 = [&raw](std::size_t at, unsigned& v) {
+        if (at + 4 > raw.size())
+            return false;
+        auto r = std::from_chars(raw.data() + at, raw.data() + at + 4, v, 16);
+        return r.ec == std::errc() && r.ptr == raw.data() + at + 4;
+    };
+
+    for (std::size_t i = 0; i < raw.size(); i++) {
+        char c = raw[i];
+        if (c != '\\' || i + 1 >= raw.size()) {
+            out.push_back(c);
+            continue;
+        }
+        c = raw[++i];
+        switch (c) {
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                unsigned cp, lo;
+                if (!hex4(i + 1, cp)) {
+                    out.push_back('u');
+                    break;
+                }
+                i += 4;
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 2 < raw.size() && raw[i + 1] == '\\' &&
+                        raw[i + 2] == 'u' && hex4(i + 3, lo) && lo >= 0xDC00 && lo < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    i += 6;
+                }
+                if (cp < 0x80) {
+                    out.push_back(static_cast<char>(cp));
+                } else if (cp < 0x800) {
+                    out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+                    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                } else if (cp < 0x10000) {
+                    out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+                    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                } else {
+                    out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+                    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+                    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                }
+                break;
+            }
+            default:
+                // \" \\ \/ and anything unknown stand for themselves
+                out.push_back(c);
+        }
+    }
+}
+
+void json_string(FILE* out, const std::string& s) {
+    std::fputc('"', out);
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', out);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            std::fprintf(out, "\\u%04x", static_cast<unsigned>(c));
+            continue;
+        }
+        std::fputc(c, out);
+    }
+    std::fputc('"', out);
+}
+
+// CSV text field; quoted only when it has to be, so plain values print as-is
+void csv_string(FILE* out, const std::string& s) {
+    if (s.find_first_of(",\"\r\n") == std::string::npos) {
+        std::fputs(s.c_str(), out);
+        return;
+    }
+    std::fputc('"', out);
+    for (char c : s) {
+        if (c == '"')
+            std::fputc('"', out);
+        std::fputc(c, out);
+    }
+    std::fputc('"', out);
+}
+
+// collector.py --gps-only lines (rat GPS, key "---") carry a position but no cell
+bool has_cell_identity(const observation& o) {
+    if (o.rat == "GPS")
+        return false;
+    if (!o.mcc.empty() || !o.mnc.empty() || !o.tac.empty() || !o.cid.empty())
+        return true;
+    return o.key.find_first_not_of('-') != std::string_view::npos;
+}
+
+void process_chunk(const Args& args, chunk& c, worker_state& ws) {
+    std::string key, device_id;
+    const char* p = c.begin;
+    const long pagesz = sysconf(_SC_PAGESIZE);
+    const char* released =
+        c.map_base + static_cast<std::size_t>(c.begin - c.map_base) / pagesz * pagesz;
+    while (p < c.end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(c.end - p)));
+        const char* le = nl ? nl : c.end;
+
+        if (le > p) {
+            ws.lines++;
+            observation o;
+            if (!parse_line(p, le, o)) {
+                ws.bad_lines++;
+            } else if (!has_cell_identity(o)) {
+                ws.no_cell_lines++;
+            } else if (!args.have_bbox ||
+                       (o.has_pos && o.lat >= args.min_lat && o.lat <= args.max_lat &&
+                        o.lon >= args.min_lon && o.lon <= args.max_lon)) {
+                // Values are unescaped once here; every output escapes its own way
+                key.clear();
+                if (o.key.empty()) {
+                    // Older archives without full_cell_key; same layout as collector.py
+                    append_unescaped(key, o.mcc);
+                    key += '-';
+                    append_unescaped(key, o.mnc);
+                    key += '-';
+                    append_unescaped(key, o.tac);
+                    key += '-';
+                    append_unescaped(key, o.cid);
+                } else {
+                    append_unescaped(key, o.key);
+                }
+
+                int sig = 0;
+                bool has_sig = false;
+                if (o.has_rsrp) {
+                    sig = o.rsrp;
+                    has_sig = true;
+                } else if (o.has_rssi) {
+                    sig = o.rssi;
+                    has_sig = true;
+                }
+
+                if (args.want_cells || args.want_plmn) {
+                    auto& a = ws.cells[key];
+                    if (a.observations == 0) {
+                        append_unescaped(a.plmn, o.mcc);
+                        append_unescaped(a.plmn, o.mnc);
+                        append_unescaped(a.rat, o.rat);
+                        append_unescaped(a.band, o.band);
+                    } else if (a.band.empty() && !o.band.empty()) {
+                        append_unescaped(a.band, o.band);
+                    }
+                    a.observations++;
+                    if (has_sig) {
+                        a.best = std::max(a.best, sig);
+                        a.worst = std::min(a.worst, sig);
+                    }
+                    if (o.has_ts) {
+                        a.first_seen = std::min(a.first_seen, o.ts);
+                        a.last_seen = std::max(a.last_seen, o.ts);
+                    }
+                }
+
+                if (args.want_obs && c.obs_out) {
+                    device_id.clear();
+                    append_unescaped(device_id, o.device_id);
+                    // Missing values are null in JSON and empty in CSV, never 0
+                    if (args.json) {
+                        if (o.has_ts)
+                            std::fprintf(c.obs_out, "{\"ts\":%.3f,\"device_id\":", o.ts);
+                        else
+                            std::fputs("{\"ts\":null,\"device_id\":", c.obs_out);
+                        json_string(c.obs_out, device_id);
+                        std::fputs(",\"full_cell_key\":", c.obs_out);
+                        json_string(c.obs_out, key);
+                        if (o.has_pos)
+                            std::fprintf(c.obs_out, ",\"lat\":%.7f,\"lon\":%.7f", o.lat, o.lon);
+                        else
+                            std::fputs(",\"lat\":null,\"lon\":null", c.obs_out);
+                        if (has_sig)
+                            std::fprintf(c.obs_out, ",\"signal\":%d}\n", sig);
+                        else
+                            std::fputs(",\"signal\":null}\n", c.obs_out);
+                    } else {
+                        if (o.has_ts)
+                            std::fprintf(c.obs_out, "%.3f", o.ts);
+                        std::fputc(',', c.obs_out);
+                        csv_string(c.obs_out, device_id);
+                        std::fputc(',', c.obs_out);
+                        csv_string(c.obs_out, key);
+                        std::fputc(',', c.obs_out);
+                        if (o.has_pos)
+                            std::fprintf(c.obs_out, "%.7f,%.7f", o.lat, o.lon);
+                        else
+                            std::fputc(',', c.obs_out);
+                        if (has_sig)
+                            std::fprintf(c.obs_out, ",%d\n", sig);
+                        else
+                            std::fputs(",\n", c.obs_out);
+                    }
+                }
+            }
+        }
+
+        p = nl ? nl + 1 : c.end;
+
+        // Let the kernel reclaim what we've already scanned
+        if (static_cast<std::size_t>(p - released) > kReleaseWindow) {
+            auto off = static_cast<std::size_t>(p - c.map_base) / pagesz * pagesz;
+            const char* upto = c.map_base + off;
+            if (upto > released) {
+                madvise(const_cast<char*>(released), static_cast<std::size_t>(upto - released), MADV_DONTNEED);
+                released = upto;
+            }
+        }
+    }
+}
+
+struct mapping {
+    const char* base = nullptr;
+    std::size_t size = 0;
+};
+
+bool map_file(const std::string& path, mapping& m) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror(path.c_str());
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror(path.c_str());
+        close(fd);
+        return false;
+    }
+    m.size = static_cast<std::size_t>(st.st_size);
+    if (m.size == 0) {
+        close(fd);
+        return true;
+    }
+    void* p = mmap(nullptr, m.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror(path.c_str());
+        return false;
+    }
+    madvise(p, m.size, MADV_SEQUENTIAL);
+    m.base = static_cast<const char*>(p);
+    return true;
+}
+
+// Unlinked temporary file for one worker's obs rows
+FILE* open_spill() {
+    const char* dir = std::getenv("TMPDIR");
+    std::string path = std::string(dir && *dir ? dir : "/var/tmp") + "/cell_query.XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        perror(path.c_str());
+        return nullptr;
+    }
+    unlink(path.c_str());
+    FILE* f = fdopen(fd, "w+");
+    if (!f) {
+        perror(path.c_str());
+        close(fd);
+    }
+    return f;
+}
+
+// Split a mapping into chunks that each start at a line boundary
+void split_mapping(const mapping& m, std::vector<chunk>& out) {
+    const char* p = m.base;
+    const char* end = m.base + m.size;
+    while (p < end) {
+        const char* e = p + std::min(kChunkSize, static_cast<std::size_t>(end - p));
+        if (e < end) {
+            const char* nl = static_cast<const char*>(std::memchr(e, '\n', static_cast<std::size_t>(end - e)));
+            e = nl ? nl + 1 : end;
+        }
+        out.push_back(chunk{p, e, m.base});
+        p = e;
+    }
+}
+
+void emit_plmn(FILE* out, const Args& args, const std::unordered_map<std::string, cell_agg>& cells) {
+    std::map<std::tuple<std::string, std::string, std::string>, plmn_agg> plmn;
+    for (const auto& kv : cells) {
+        auto& p = plmn[std::make_tuple(kv.second.plmn, kv.second.rat, kv.second.band)];
+        p.distinct_cells++;
+        p.observations += kv.second.observations;
+    }
+    if (args.json) {
+        std::fputs("\"plmn\":[", out);
+        bool first = true;
+        for (const auto& kv : plmn) {
+            std::fputs(first ? "\n" : ",\n", out);
+            first = false;
+            std::fputs("{\"plmn\":", out);
+            json_string(out, std::get<0>(kv.first));
+            std::fputs(",\"rat\":", out);
+            json_string(out, std::get<1>(kv.first));
+            std::fputs(",\"band\":", out);
+            json_string(out, std::get<2>(kv.first));
+            std::fprintf(out, ",\"distinct_cells\":%llu,\"observations\":%llu}",
+                    static_cast<unsigned long long>(kv.second.distinct_cells),
+                    static_cast<unsigned long long>(kv.second.observations));
+        }
+        std::fputs("\n]", out);
+    } else {
+        std::fputs("plmn,rat,band,distinct_cells,observations\n", out);
+        for (const auto& kv : plmn) {
+            csv_string(out, std::get<0>(kv.first));
+            std::fputc(',', out);
+            csv_string(out, std::get<1>(kv.first));
+            std::fputc(',', out);
+            csv_string(out, std::get<2>(kv.first));
+            std::fprintf(out, ",%llu,%llu\n",
+                    static_cast<unsigned long long>(kv.second.distinct_cells),
+                    static_cast<unsigned long long>(kv.second.observations));
+        }
+    }
+}
+
+void emit_cells(FILE* out, const Args& args, const std::unordered_map<std::string, cell_agg>& cells) {
+    std::vector<const std::pair<const std::string, cell_agg>*> sorted;
+    sorted.reserve(cells.size());
+    for (const auto& kv : cells)
+        sorted.push_back(&kv);
+    std::sort(sorted.begin(), sorted.end(),
+            [](const auto* a, const auto* b) { return a->first < b->first; });
+
+    if (args.json) {
+        std::fputs("\"cells\":[", out);
+        bool first = true;
+        for (const auto* kv : sorted) {
+            const auto& a = kv->second;
+            std::fputs(first ? "\n" : ",\n", out);
+            first = false;
+            std::fputs("{\"full_cell_key\":", out);
+            json_string(out, kv->first);
+            std::fputs(",\"plmn\":", out);
+            json_string(out, a.plmn);
+            std::fputs(",\"rat\":", out);
+            json_string(out, a.rat);
+            std::fputs(",\"band\":", out);
+            json_string(out, a.band);
+            std::fprintf(out, ",\"observations\":%llu", static_cast<unsigned long long>(a.observations));
+            if (a.best != std::numeric_limits<int>::min())
+                std::fprintf(out, ",\"best_signal\":%d,\"worst_signal\":%d", a.best, a.worst);
+            else
+                std::fputs(",\"best_signal\":null,\"worst_signal\":null", out);
+            if (a.first_seen <= a.last_seen)
+                std::fprintf(out, ",\"first_seen\":%.3f,\"last_seen\":%.3f}", a.first_seen, a.last_seen);
+            else
+                std::fputs(",\"first_seen\":null,\"last_seen\":null}", out);
+        }
+        std::fputs("\n]", out);
+    } else {
+        std::fputs("full_cell_key,plmn,rat,band,observations,best_signal,worst_signal,first_seen,last_seen\n", out);
+        for (const auto* kv : sorted) {
+            const auto& a = kv->second;
+            csv_string(out, kv->first);
+            std::fputc(',', out);
+            csv_string(out, a.plmn);
+            std::fputc(',', out);
+            csv_string(out, a.rat);
+            std::fputc(',', out);
+            csv_string(out, a.band);
+            std::fprintf(out, ",%llu,", static_cast<unsigned long long>(a.observations));
+            if (a.best != std::numeric_limits<int>::min())
+                std::fprintf(out, "%d,%d,", a.best, a.worst);
+            else
+                std::fputs(",,", out);
+            if (a.first_seen <= a.last_seen)
+                std::fprintf(out, "%.3f,%.3f\n", a.first_seen, a.last_seen);
+            else
+                std::fputs(",\n", out);
+        }
+    }
+}
+
+void emit_obs(FILE* out, const Args& args, std::vector<chunk>& chunks) {
+    if (args.json)
+        std::fputs("\"obs\":[", out);
+    else
+        std::fputs("ts,device_id,full_cell_key,lat,lon,signal\n", out);
+
+    bool first = true;
+    char buf[65536];
+    for (auto& c : chunks) {
+        if (!c.obs_out || c.obs_len == 0)
+            continue;
+        std::fseek(c.obs_out, c.obs_off, SEEK_SET);
+        long left = c.obs_len;
+        if (!args.json) {
+            while (left > 0) {
+                auto n = std::fread(buf, 1, std::min<std::size_t>(sizeof(buf), left), c.obs_out);
+                if (n == 0)
+                    break;
+                std::fwrite(buf, 1, n, out);
+                left -= static_cast<long>(n);
+            }
+        } else {
+            // Spill files hold one object per line; stitch them into an array
+            while (left > 0 && std::fgets(buf, sizeof(buf), c.obs_out)) {
+                std::size_t n = std::strlen(buf);
+                left -= static_cast<long>(n);
+                if (n && buf[n - 1] == '\n')
+                    buf[--n] = '\0';
+                std::fputs(first ? "\n" : ",\n", out);
+                first = false;
+                std::fputs(buf, out);
+            }
+        }
+    }
+    if (args.json)
+        std::fputs("\n]", out);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Args args = parse_args(argc, argv);
+    if (args.files.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<mapping> maps;
+    std::vector<chunk> chunks;
+    for (const auto& f : args.files) {
+        mapping m;
+        if (!map_file(f, m))
+            return 1;
+        if (m.base) {
+            maps.push_back(m);
+            split_mapping(m, chunks);
+        }
+    }
+
+    unsigned int nthreads = std::min<std::size_t>(args.threads, std::max<std::size_t>(chunks.size(), 1));
+    std::vector<worker_state> states(nthreads);
+
+    if (args.want_obs) {
+        for (auto& ws : states) {
+            ws.obs_spill = open_spill();
+            if (!ws.obs_spill)
+                return 1;
+        }
+    }
+
+    std::atomic<std::size_t> next_chunk{0};
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < nthreads; t++) {
+        workers.emplace_back([&, t]() {
+            std::size_t i;
+            while ((i = next_chunk.fetch_add(1)) < chunks.size()) {
+                auto& c = chunks[i];
+                c.obs_out = states[t].obs_spill;
+                if (c.obs_out)
+                    c.obs_off = std::ftell(c.obs_out);
+                process_chunk(args, c, states[t]);
+                if (c.obs_out)
+                    c.obs_len = std::ftell(c.obs_out) - c.obs_off;
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+
+    // Fold per-thread tables into the first one
+    auto& cells = states[0].cells;
+    uint64_t lines = states[0].lines, bad = states[0].bad_lines, no_cell = states[0].no_cell_lines;
+    for (unsigned int t = 1; t < nthreads; t++) {
+        for (auto& kv : states[t].cells) {
+            auto it = cells.find(kv.first);
+            if (it == cells.end())
+                cells.emplace(kv.first, std::move(kv.second));
+            else
+                it->second.merge(kv.second);
+        }
+        lines += states[t].lines;
+        bad += states[t].bad_lines;
+        no_cell += states[t].no_cell_lines;
+    }
+
+    FILE* out = stdout;
+    if (!args.output.empty()) {
+        out = std::fopen(args.output.c_str(), "w");
+        if (!out) {
+            perror(args.output.c_str());
+            return 1;
+        }
+    }
+
+    if (args.json)
+        std::fputs("{", out);
+    bool need_sep = false;
+    auto separator = [&]() {
+        if (need_sep)
+            std::fputs(args.json ? ",\n" : "\n", out);
+        need_sep = true;
+    };
+    if (args.want_plmn) {
+        separator();
+        emit_plmn(out, args, cells);
+    }
+    if (args.want_cells) {
+        separator();
+        emit_cells(out, args, cells);
+    }
+    if (args.want_obs) {
+        separator();
+        emit_obs(out, args, chunks);
+    }
+    if (args.json)
+        std::fputs("}\n", out);
+
+    if (out != stdout)
+        std::fclose(out);
+    for (auto& ws : states)
+        if (ws.obs_spill)
+            std::fclose(ws.obs_spill);
+    for (const auto& m : maps)
+        munmap(const_cast<char*>(m.base), m.size);
+
+    std::cerr << "Scanned " << lines << " line(s) with " << nthreads << " thread(s), "
+              << bad << " skipped, " << no_cell << " without a cell, "
+              << cells.size() << " cell(s)\n";
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Fixed-layout normalized cell record
+ *
+ * In normalize mode the capture helper parses the phone JSON itself, picks the
+ * serving cell, derives band and frequencies, builds the composite key, and
+ * sends one of these records as packet data (DLT CELL_RECORD_DLT) instead of
+ * the JSON text.  The Kismet PHY then only copies fields into the device.
+ *
+ * All integers are little-endian; strings are NUL padded and always
+ * terminated.  A value of 0 in rssi/rsrp/rsrq means not reported, matching
+ * the JSON path.
+ */
+
+#ifndef __CELL_RECORD_H__
+#define __CELL_RECORD_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "vendor/kis_endian.h"
+
+/* LINKTYPE_USER0 */
+#define CELL_RECORD_DLT         147
+
+#define CELL_RECORD_MAGIC       0x43524543  /* "CERC" read as LE bytes */
+#define CELL_RECORD_VERSION     1
+
+#define CELL_REC_REGISTERED     (1 << 0)
+#define CELL_REC_HAS_ARFCN      (1 << 1)
+#define CELL_REC_HAS_PCI        (1 << 2)
+#define CELL_REC_HAS_BAND       (1 << 3)
+#define CELL_REC_HAS_DL_FREQ    (1 << 4)
+#define CELL_REC_HAS_UL_FREQ    (1 << 5)
+#define CELL_REC_HAS_TA         (1 << 6)
+#define CELL_REC_HAS_LOCATION   (1 << 7)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint32_t flags;
+
+    int32_t arfcn;
+    int32_t pci;
+    int32_t band;
+    int32_t timing_advance;
+
+    int16_t rssi;
+    int16_t rsrp;
+    int16_t rsrq;
+    int16_t reserved;
+
+    uint32_t dl_freq_khz;
+    uint32_t ul_freq_khz;
+
+    /* Phone position */
+    int32_t lat_e7;
+    int32_t lon_e7;
+    int32_t alt_cm;
+    uint32_t speed_cmps;
+    uint32_t heading_cdeg;
+    uint32_t accuracy_cm;
+
+    char rat[8];
+    char mcc[4];
+    char mnc[4];
+    char tac[12];
+    char cid[24];
+    /* Stable identity used for the device MAC; full_cell_key if the phone sent
+     * one, else the composite */
+    char fullid[64];
+    /* <mcc><mnc>-<tac/lac>-<cid/full_cell_id> */
+    char composite[64];
+} __attribute__((packed)) cell_record_t;
+
+/* Validate the header of a received record; returns 1 if usable */
+static inline int cell_record_check(const uint8_t *data, size_t len) {
+    cell_record_t hdr;
+    if (len < sizeof(cell_record_t))
+        return 0;
+    memcpy(&hdr, data, 12);
+    return le32toh(hdr.magic) == CELL_RECORD_MAGIC &&
+        le16toh(hdr.version) == CELL_RECORD_VERSION &&
+        le16toh(hdr.length) == sizeof(cell_record_t);
+}
+
+#endif
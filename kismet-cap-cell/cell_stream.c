@@ -0,0 +1,285 @@
+/*
+ * Phone stream decoding for the capture helper; see cell_stream.h
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "cell_stream.h"
+
+/* First byte of a zstd frame (magic 0xFD2FB528, little endian) */
+#define ZSTD_FIRST_BYTE 0x28
+
+/* Cap the decoder window at 8 MiB whatever the frame header asks for; the
+ * phone flushes every line and never needs more than a few KiB */
+#define ZSTD_WINDOW_LOG_MAX 23
+
+#ifdef HAVE_ZSTD
+/* Dictionary id from a zstd frame header (RFC 8878 3.1.1.1).  Returns 1
+ * with *id set, 0 if more bytes are needed, or -1 for anything that is not
+ * a zstd frame, which the decoder then reports. */
+static int frame_dict_id(const unsigned char *p, size_t len, unsigned int *id) {
+    static const size_t did_size[4] = { 0, 1, 2, 4 };
+
+    if (len < 5)
+        return 0;
+    if (p[0] != 0x28 || p[1] != 0xB5 || p[2] != 0x2F || p[3] != 0xFD)
+        return -1;
+
+    unsigned char fhd = p[4];
+    size_t off = 5 + ((fhd & 0x20) ? 0 : 1);
+    size_t n = did_size[fhd & 0x03];
+    if (len < off + n)
+        return 0;
+
+    *id = 0;
+    for (size_t i = 0; i < n; i++)
+        *id |= (unsigned int) p[off + i] << (8 * i);
+    return 1;
+}
+
+static uint64_t thread_cpu_us(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+        return 0;
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
+
+int cell_stream_zstd_available(void) {
+#ifdef HAVE_ZSTD
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+int cell_stream_init(cell_stream_t *s, int request_zstd, const char *dict_path,
+                     char *err, size_t errlen) {
+    memset(s, 0, sizeof(*s));
+
+#ifdef HAVE_ZSTD
+    s->request_zstd = request_zstd;
+
+    s->dctx = ZSTD_createDCtx();
+    if (s->dctx == NULL) {
+        snprintf(err, errlen, "unable to allocate zstd decoder");
+        return -1;
+    }
+    ZSTD_DCtx_setParameter((ZSTD_DCtx *) s->dctx, ZSTD_d_windowLogMax, ZSTD_WINDOW_LOG_MAX);
+
+    if (dict_path != NULL && dict_path[0] != '\0') {
+        FILE *f = fopen(dict_path, "rb");
+        if (f == NULL) {
+            snprintf(err, errlen, "unable to open zstd dictionary %s: %s", dict_path, strerror(errno));
+            return -1;
+        }
+
+        char *dict = NULL;
+        size_t len = 0;
+        if (fseek(f, 0, SEEK_END) == 0) {
+            long end = ftell(f);
+            if (end > 0 && fseek(f, 0, SEEK_SET) == 0) {
+                dict = (char *) malloc((size_t) end);
+                if (dict != NULL)
+                    len = fread(dict, 1, (size_t) end, f);
+            }
+        }
+        fclose(f);
+
+        if (len > 0)
+            s->ddict = ZSTD_createDDict(dict, len);
+        free(dict);
+
+        if (s->ddict == NULL) {
+            snprintf(err, errlen, "%s is not a usable zstd dictionary", dict_path);
+            return -1;
+        }
+
+        /* Referenced per frame, once its header names it */
+        s->dict_id = ZSTD_getDictID_fromDDict((const ZSTD_DDict *) s->ddict);
+    }
+#else
+    (void) request_zstd;
+    (void) dict_path;
+    (void) err;
+    (void) errlen;
+#endif
+
+    return 0;
+}
+
+void cell_stream_free(cell_stream_t *s) {
+#ifdef HAVE_ZSTD
+    ZSTD_freeDCtx((ZSTD_DCtx *) s->dctx);
+    ZSTD_freeDDict((ZSTD_DDict *) s->ddict);
+#endif
+    s->dctx = NULL;
+    s->ddict = NULL;
+}
+
+int cell_stream_connected(cell_stream_t *s, int fd) {
+    s->mode = CELL_STREAM_UNKNOWN;
+    s->in_len = s->in_pos = 0;
+    s->out_full = 0;
+    s->frame_start = 1;
+    s->header_short = 0;
+    s->error = NULL;
+
+#ifdef HAVE_ZSTD
+    /* Drops the half-read frame; the dictionary is picked again per frame */
+    ZSTD_DCtx_reset((ZSTD_DCtx *) s->dctx, ZSTD_reset_session_only);
+
+    if (s->request_zstd) {
+        char hello[64];
+        int len = snprintf(hello, sizeof(hello), "{\"stream\":\"zstd\",\"dict\":%u}\n", s->dict_id);
+        /* Fits the socket buffer of a fresh connection in one write */
+        if (write(fd, hello, (size_t) len) != len)
+            return -1;
+    }
+#else
+    (void) fd;
+#endif
+
+    return 0;
+}
+
+int cell_stream_pending(const cell_stream_t *s) {
+    return s->mode == CELL_STREAM_ZSTD &&
+        ((s->in_pos < s->in_len && !s->header_short) || s->out_full);
+}
+
+#ifdef HAVE_ZSTD
+/* At a frame boundary: reference the dictionary if the frame was made
+ * with it, none if it was made without.  Returns 0 if the header is still
+ * incomplete, -1 if the frame needs a dictionary the helper doesn't have. */
+static int select_dict(cell_stream_t *s) {
+    unsigned int id = 0;
+    int r = frame_dict_id(s->in + s->in_pos, s->in_len - s->in_pos, &id);
+    if (r == 0) {
+        s->header_short = 1;
+        return 0;
+    }
+
+    if (r > 0 && id != 0 && id != s->dict_id) {
+        s->error = "stream uses a zstd dictionary this helper doesn't have (zdict=)";
+        s->errors++;
+        s->in_pos = s->in_len = 0;
+        return -1;
+    }
+
+    ZSTD_DCtx_refDDict((ZSTD_DCtx *) s->dctx,
+            r > 0 && id != 0 ? (const ZSTD_DDict *) s->ddict : NULL);
+    s->frame_start = 0;
+    return 1;
+}
+
+static ssize_t inflate_pending(cell_stream_t *s, char *out, size_t outlen) {
+    if (s->frame_start && s->in_pos < s->in_len) {
+        int r = select_dict(s);
+        if (r <= 0)
+            return r;
+    }
+
+    ZSTD_outBuffer ob = { out, outlen, 0 };
+    ZSTD_inBuffer ib = { s->in, s->in_len, s->in_pos };
+    uint64_t start = thread_cpu_us();
+
+    /* A frame header or a partial block can be consumed without output;
+     * keep going until there is some or the input runs out.  Stop at the
+     * end of a frame so the next one gets its own dictionary check. */
+    do {
+        size_t r = ZSTD_decompressStream((ZSTD_DCtx *) s->dctx, &ob, &ib);
+        if (ZSTD_isError(r)) {
+            s->error = ZSTD_getErrorName(r);
+            s->errors++;
+            s->in_pos = s->in_len = 0;
+            return -1;
+        }
+        if (r == 0) {
+            s->frame_start = 1;
+            break;
+        }
+    } while (ob.pos == 0 && ib.pos < ib.size);
+
+    s->inflate_us += thread_cpu_us() - start;
+    s->in_pos = ib.pos;
+    s->out_full = ob.pos == ob.size;
+    if (s->in_pos == s->in_len)
+        s->in_pos = s->in_len = 0;
+
+    return (ssize_t) ob.pos;
+}
+#endif
+
+ssize_t cell_stream_read(cell_stream_t *s, int fd, char *out, size_t outlen) {
+    s->error = NULL;
+
+#ifdef HAVE_ZSTD
+    if (cell_stream_pending(s))
+        return inflate_pending(s, out, outlen);
+#endif
+
+    if (s->mode == CELL_STREAM_PLAIN) {
+        ssize_t n = read(fd, out, outlen);
+        if (n <= 0)
+            return -1;
+        s->wire_bytes += n;
+        return n;
+    }
+
+    if (s->mode == CELL_STREAM_UNKNOWN) {
+        /* First bytes of the connection go straight to the caller, and are
+         * moved aside only if they turn out to be compressed */
+        if (outlen > sizeof(s->in))
+            outlen = sizeof(s->in);
+        ssize_t n = read(fd, out, outlen);
+        if (n <= 0)
+            return -1;
+        s->wire_bytes += n;
+
+        if ((unsigned char) out[0] != ZSTD_FIRST_BYTE) {
+            s->mode = CELL_STREAM_PLAIN;
+            return n;
+        }
+
+#ifdef HAVE_ZSTD
+        s->mode = CELL_STREAM_ZSTD;
+        memcpy(s->in, out, (size_t) n);
+        s->in_len = (size_t) n;
+        s->in_pos = 0;
+        return inflate_pending(s, out, outlen);
+#else
+        s->error = "compressed stream, but this helper was built without zstd";
+        s->errors++;
+        return -1;
+#endif
+    }
+
+#ifdef HAVE_ZSTD
+    /* Keep the start of a frame header that arrived split */
+    size_t keep = s->in_len - s->in_pos;
+    if (keep > 0)
+        memmove(s->in, s->in + s->in_pos, keep);
+    s->in_pos = 0;
+    s->in_len = keep;
+
+    ssize_t n = read(fd, s->in + keep, sizeof(s->in) - keep);
+    if (n <= 0)
+        return -1;
+    s->wire_bytes += n;
+    s->in_len += (size_t) n;
+    s->header_short = 0;
+    return inflate_pending(s, out, outlen);
+#else
+    return -1;
+#endif
+}
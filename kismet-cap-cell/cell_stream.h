@@ -0,0 +1,84 @@
+/*
+ * Phone stream decoding for the capture helper
+ *
+ * The phone sends newline-terminated JSON.  Over Wi-Fi or a remote relay the
+ * helper may ask for the same lines as a zstd stream instead: after
+ * connecting it writes one hello line naming the dictionary it holds, and a
+ * phone that understands it answers with zstd frames, flushed after every
+ * line.  A phone that doesn't never reads the hello and keeps sending JSON.
+ *
+ * Which one arrived is decided per connection from the first byte: JSON
+ * starts with '{' (or whitespace), a zstd frame with its magic (0x28).
+ * Decompression is incremental, straight into the caller's line buffer, so
+ * line splitting is the same in both modes.
+ *
+ * A phone without the matching dictionary compresses without one.  The
+ * dictionary id in each frame header decides whether the helper's
+ * dictionary is referenced for that frame; decoding a plain frame with a
+ * dictionary attached would start from the wrong entropy state.
+ *
+ * Without HAVE_ZSTD no hello is sent and a compressed stream is refused.
+ */
+
+#ifndef __CELL_STREAM_H__
+#define __CELL_STREAM_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define CELL_STREAM_UNKNOWN 0
+#define CELL_STREAM_PLAIN 1
+#define CELL_STREAM_ZSTD 2
+
+typedef struct {
+    int mode;                   /* CELL_STREAM_*, for the current connection */
+    int request_zstd;
+    unsigned int dict_id;       /* 0 when no dictionary is loaded */
+
+    void *dctx;                 /* ZSTD_DCtx */
+    void *ddict;                /* ZSTD_DDict */
+
+    /* Compressed bytes read but not yet decompressed */
+    unsigned char in[8192];
+    size_t in_len;
+    size_t in_pos;
+    /* Last call filled the output; the decoder may be holding more */
+    int out_full;
+    /* Next input byte starts a frame; its header picks the dictionary */
+    int frame_start;
+    /* Waiting on the socket for the rest of that frame header */
+    int header_short;
+
+    /* Cumulative since helper start */
+    uint64_t wire_bytes;
+    uint64_t inflate_us;        /* thread CPU spent decompressing */
+    uint64_t errors;
+
+    const char *error;          /* why the last read failed, if not EOF */
+} cell_stream_t;
+
+/* Returns 1 if the helper was built with zstd */
+int cell_stream_zstd_available(void);
+
+/* Set up a decoder.  request_zstd asks phones for a compressed stream;
+ * dict_path (may be NULL) names a dictionary from train_zstd_dict.sh.
+ * Returns -1 with err filled if the dictionary can't be loaded. */
+int cell_stream_init(cell_stream_t *s, int request_zstd, const char *dict_path,
+                     char *err, size_t errlen);
+void cell_stream_free(cell_stream_t *s);
+
+/* Start of a new connection: forget the previous mode and decoder state,
+ * and send the hello if compression was requested.  Returns -1 if the
+ * hello could not be written. */
+int cell_stream_connected(cell_stream_t *s, int fd);
+
+/* 1 if cell_stream_read can produce output without reading the socket,
+ * so the caller should not wait for it to become readable */
+int cell_stream_pending(const cell_stream_t *s);
+
+/* Read from fd and put up to outlen bytes of plain JSON lines in out.
+ * Returns the byte count, 0 if nothing was decoded yet (a frame header or
+ * a partial block), or -1 on EOF or error; error is set for the latter. */
+ssize_t cell_stream_read(cell_stream_t *s, int fd, char *out, size_t outlen);
+
+#endif
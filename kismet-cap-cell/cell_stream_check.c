@@ -0,0 +1,252 @@
+/*
+ * Round-trip check for cell_stream.c; built and run by
+ * `./build_capture.sh check` when libzstd is available.
+ *
+ * Each case writes synthetic phone lines through a socketpair, plain or as
+ * a zstd stream flushed per line the way the phone does it, and decodes
+ * them with cell_stream_read.  Covers the helper and phone dictionary
+ * agreeing, the phone falling back to no dictionary, a dictionary the
+ * helper doesn't have, frame headers split across reads, and a dictionary
+ * change between frames of one connection.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <zdict.h>
+#include <zstd.h>
+
+#include "cell_stream.h"
+
+#define NUM_LINES 1000
+#define DICT_MAX 16384
+
+static char *lines[NUM_LINES];
+static size_t line_len[NUM_LINES];
+
+typedef struct {
+    int fd;
+    /* Per frame: dictionary (NULL for none); frames split the lines evenly */
+    const void *dicts[2];
+    size_t dict_lens[2];
+    int frames;             /* 0 for plain JSON */
+    size_t chunk;           /* write size, to split headers across reads */
+} writer_args;
+
+static void write_all(int fd, const char *p, size_t len, size_t chunk) {
+    while (len > 0) {
+        size_t n = chunk && chunk < len ? chunk : len;
+        ssize_t w = write(fd, p, n);
+        if (w <= 0)
+            return;
+        p += w;
+        len -= (size_t) w;
+    }
+}
+
+static void *writer(void *arg) {
+    writer_args *a = (writer_args *) arg;
+    char out[65536];
+
+    if (a->frames == 0) {
+        for (int i = 0; i < NUM_LINES; i++)
+            write_all(a->fd, lines[i], line_len[i], a->chunk);
+        close(a->fd);
+        return NULL;
+    }
+
+    ZSTD_CCtx *c = ZSTD_createCCtx();
+    int per_frame = NUM_LINES / a->frames;
+
+    for (int f = 0; f < a->frames; f++) {
+        ZSTD_CCtx_reset(c, ZSTD_reset_session_and_parameters);
+        ZSTD_CCtx_setParameter(c, ZSTD_c_compressionLevel, 3);
+        if (a->dicts[f] != NULL)
+            ZSTD_CCtx_loadDictionary(c, a->dicts[f], a->dict_lens[f]);
+
+        int last = f == a->frames - 1 ? NUM_LINES : (f + 1) * per_frame;
+        for (int i = f * per_frame; i < last; i++) {
+            ZSTD_inBuffer ib = { lines[i], line_len[i], 0 };
+            ZSTD_EndDirective mode = i == last - 1 ? ZSTD_e_end : ZSTD_e_flush;
+            size_t r;
+            do {
+                ZSTD_outBuffer ob = { out, sizeof(out), 0 };
+                r = ZSTD_compressStream2(c, &ob, &ib, mode);
+                write_all(a->fd, out, ob.pos, a->chunk);
+            } while (r != 0 && !ZSTD_isError(r));
+        }
+    }
+
+    ZSTD_freeCCtx(c);
+    close(a->fd);
+    return NULL;
+}
+
+/* Returns the number of lines decoded intact, or -1 if the stream failed */
+static int run(const char *helper_dict, writer_args *a) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+        return -1;
+
+    cell_stream_t s;
+    char err[256];
+    if (cell_stream_init(&s, 1, helper_dict, err, sizeof(err)) < 0) {
+        fprintf(stderr, "%s\n", err);
+        return -1;
+    }
+    cell_stream_connected(&s, sv[0]);
+
+    /* Swallow the hello so the writer never blocks on it */
+    char hello[64];
+    if (read(sv[1], hello, sizeof(hello)) <= 0)
+        return -1;
+
+    a->fd = sv[1];
+    pthread_t t;
+    pthread_create(&t, NULL, writer, a);
+
+    char buf[8192];
+    size_t nbuf = 0;
+    int good = 0, seen = 0, failed = 0;
+
+    for (;;) {
+        ssize_t n = cell_stream_read(&s, sv[0], buf + nbuf, sizeof(buf) - nbuf);
+        if (n < 0) {
+            failed = s.error != NULL;
+            break;
+        }
+
+        nbuf += (size_t) n;
+        size_t start = 0;
+        for (size_t i = 0; i < nbuf; i++) {
+            if (buf[i] != '\n')
+                continue;
+            if (seen < NUM_LINES && i + 1 - start == line_len[seen] &&
+                    memcmp(buf + start, lines[seen], line_len[seen]) == 0)
+                good++;
+            seen++;
+            start = i + 1;
+        }
+        memmove(buf, buf + start, nbuf - start);
+        nbuf -= start;
+    }
+
+    /* Unblock a writer stuck on a stream the reader gave up on */
+    close(sv[0]);
+    pthread_join(t, NULL);
+    cell_stream_free(&s);
+
+    return failed ? -1 : good;
+}
+
+static size_t train(void *dict, int salt) {
+    size_t total = 0;
+    for (int i = 0; i < NUM_LINES; i++)
+        total += line_len[i];
+
+    char *all = malloc(total);
+    size_t *sizes = malloc(sizeof(size_t) * NUM_LINES);
+    size_t off = 0;
+    for (int i = 0; i < NUM_LINES; i++) {
+        memcpy(all + off, lines[i], line_len[i]);
+        /* A second, different dictionary from perturbed samples */
+        if (salt)
+            all[off + 2] ^= (char) salt;
+        sizes[i] = line_len[i];
+        off += line_len[i];
+    }
+
+    size_t len = ZDICT_trainFromBuffer(dict, DICT_MAX, all, sizes, NUM_LINES);
+    free(all);
+    free(sizes);
+    return ZDICT_isError(len) ? 0 : len;
+}
+
+static int check(const char *name, int got, int want) {
+    int ok = got == want;
+    printf("%-44s %s (%d)\n", name, ok ? "ok" : "FAIL", got);
+    return ok ? 0 : 1;
+}
+
+int main(void) {
+    const char *rats[] = { "LTE", "NR", "WCDMA", "GSM" };
+
+    /* The writer may outlive a reader that rejected its stream */
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    for (int i = 0; i < NUM_LINES; i++) {
+        char tmp[512];
+        int len = snprintf(tmp, sizeof(tmp),
+                "{\"ts\":%d,\"lat\":40.%06d,\"lon\":-75.%06d,\"cells\":[{\"rat\":\"%s\","
+                "\"registered\":true,\"mcc\":\"310\",\"mnc\":\"260\",\"tac\":%d,\"cid\":%d,"
+                "\"pci\":%d,\"earfcn\":%d,\"rsrp\":%d,\"rsrq\":%d}]}\n",
+                1700000000 + i, (i * 7919) % 1000000, (i * 104729) % 1000000, rats[i % 4],
+                1000 + i % 17, 50000 + i * 13, i % 504, 5230 + (i % 3) * 100,
+                -70 - i % 50, -5 - i % 15);
+        lines[i] = strdup(tmp);
+        line_len[i] = (size_t) len;
+    }
+
+    static char dict_a[DICT_MAX], dict_b[DICT_MAX];
+    size_t len_a = train(dict_a, 0), len_b = train(dict_b, 0x5a);
+    if (len_a == 0 || len_b == 0) {
+        fprintf(stderr, "unable to train test dictionaries\n");
+        return 1;
+    }
+    if (ZSTD_getDictID_fromDict(dict_a, len_a) == ZSTD_getDictID_fromDict(dict_b, len_b)) {
+        fprintf(stderr, "test dictionaries share an id\n");
+        return 1;
+    }
+
+    char path[] = "/tmp/cell_stream_check_XXXXXX";
+    int dfd = mkstemp(path);
+    if (dfd < 0 || write(dfd, dict_a, len_a) != (ssize_t) len_a) {
+        fprintf(stderr, "unable to write test dictionary\n");
+        return 1;
+    }
+    close(dfd);
+
+    int fails = 0;
+    writer_args a;
+
+    memset(&a, 0, sizeof(a));
+    fails += check("plain JSON, helper has dictionary", run(path, &a), NUM_LINES);
+
+    memset(&a, 0, sizeof(a));
+    a.frames = 1;
+    fails += check("zstd, no dictionary either side", run(NULL, &a), NUM_LINES);
+
+    a.dicts[0] = dict_a;
+    a.dict_lens[0] = len_a;
+    fails += check("zstd, dictionaries match", run(path, &a), NUM_LINES);
+
+    a.chunk = 3;
+    fails += check("zstd, dictionaries match, 3-byte writes", run(path, &a), NUM_LINES);
+
+    memset(&a, 0, sizeof(a));
+    a.frames = 1;
+    fails += check("zstd, phone fell back to no dictionary", run(path, &a), NUM_LINES);
+
+    a.dicts[0] = dict_b;
+    a.dict_lens[0] = len_b;
+    fails += check("zstd, phone has another dictionary", run(path, &a), -1);
+
+    memset(&a, 0, sizeof(a));
+    a.frames = 2;
+    a.dicts[0] = dict_a;
+    a.dict_lens[0] = len_a;
+    a.chunk = 2;
+    fails += check("zstd, dictionary then none in one stream", run(path, &a), NUM_LINES);
+
+    unlink(path);
+    for (int i = 0; i < NUM_LINES; i++)
+        free(lines[i]);
+
+    return fails ? 1 : 0;
+}
@@ -116,7 +116,7 @@ log "Installing build/runtime dependencies"
 apt-get update
 apt-get install -y \
   build-essential pkg-config git curl ca-certificates python3 \
-  libprotobuf-c-dev protobuf-c-compiler libcap-dev \
+  libprotobuf-c-dev protobuf-c-compiler libcap-dev libzstd-dev zstd \
   libnl-3-dev libnl-genl-3-dev libnl-route-3-dev \
   libmicrohttpd-dev libpcap-dev libnss3-dev libiw-dev libsqlite3-dev \
   zlib1g-dev libnm-dev libavahi-client-dev libusb-1.0-0-dev libudev-dev \
@@ -128,6 +128,7 @@ apt-get install -y \
 log "Building capture helper"
 pushd "${SCRIPT_DIR}" >/dev/null
 ./build_capture.sh
+./build_relay.sh
 popd >/dev/null
 
 KIS_SRC_DIR=""
@@ -169,7 +170,7 @@ install -m 755 "${SCRIPT_DIR}/cell_autoconfig.sh" "${BIN_DIR}/cell_autoconfig.sh
 install -m 755 "${SCRIPT_DIR}/kismet_cell_injector.sh" "${BIN_DIR}/kismet_cell_injector.sh"
 install -m 755 "${SCRIPT_DIR}/cell_remote_bridge.py" "${BIN_DIR}/cell_remote_bridge.py"
 install -m 755 "${SCRIPT_DIR}/cell_transport_toggle.sh" "${BIN_DIR}/cell_transport_toggle.sh"
-install -m 755 "${SCRIPT_DIR}/uds_forwarder.py" "${BIN_DIR}/uds_forwarder.py"
+install -m 755 "${SCRIPT_DIR}/kismet_cell_relay" "${BIN_DIR}/kismet_cell_relay"
 ln -sf "${BIN_DIR}/cell_transport_toggle.sh" "${BIN_DIR}/cell-transport-mode"
 
 if [[ "${WITH_COLLECTOR}" == "1" ]]; then
@@ -8,6 +8,7 @@
 
 #include <chrono>
 #include <csignal>
+#include <cstddef>
 #include <cstring>
 #include <iostream>
 #include <optional>
@@ -19,15 +20,20 @@
 static volatile std::sig_atomic_t g_stop = 0;
 
 struct Args {
+    // Leading '@' selects the Linux abstract namespace (no file on disk)
     std::string socket_path = "/var/run/kismet/cell.sock";
     bool enable_tcp = false;
     int tcp_port = 8765;  // Matches phone/collector default
     bool list_only = false;
+    // Relay mode: each socket client is spliced to a new connection here
+    std::string relay_host;
+    int relay_port = 0;
 };
 
 void usage(const char* prog) {
     std::cerr << "Usage: " << prog
-              << " [--socket /path/to.sock] [--enable-tcp --tcp-port N] [--list]\n";
+              << " [--socket /path/to.sock|@name] [--enable-tcp --tcp-port N]"
+              << " [--relay HOST:PORT] [--list]\n";
 }
 
 Args parse_args(int argc, char* argv[]) {
@@ -40,6 +46,16 @@ Args parse_args(int argc, char* argv[]) {
             args.enable_tcp = true;
         } else if (a == "--tcp-port" && i + 1 < argc) {
             args.tcp_port = std::stoi(argv[++i]);
+        } else if (a == "--relay" && i + 1 < argc) {
+            std::string r(argv[++i]);
+            auto colon = r.rfind(':');
+            if (colon == std::string::npos) {
+                args.relay_host = "127.0.0.1";
+                args.relay_port = std::stoi(r);
+            } else {
+                args.relay_host = r.substr(0, colon);
+                args.relay_port = std::stoi(r.substr(colon + 1));
+            }
         } else if (a == "--list") {
             args.list_only = true;
         } else if (a == "-h" || a == "--help") {
@@ -72,6 +88,10 @@ void handle_client(int fd, const std::string& tag) {
     std::cout << "[" << tag << "] disconnected" << std::endl;
 }
 
+bool is_abstract(const std::string& path) {
+    return !path.empty() && path[0] == '@';
+}
+
 int create_uds_listener(const std::string& path) {
     int fd = socket(AF_UNIX, SOCK_STREAM, 0);
     if (fd < 0) {
@@ -80,14 +100,21 @@ int create_uds_listener(const std::string& path) {
     }
     sockaddr_un addr{};
     addr.sun_family = AF_UNIX;
-    if (path.size() >= sizeof(addr.sun_path)) {
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
         std::cerr << "Socket path too long\n";
         close(fd);
         return -1;
     }
-    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
-    unlink(path.c_str());
-    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    socklen_t addrlen = sizeof(addr);
+    if (is_abstract(path)) {
+        // Leading NUL; the name is exactly the bytes after it, not padded
+        std::memcpy(addr.sun_path + 1, path.data() + 1, path.size() - 1);
+        addrlen = offsetof(sockaddr_un, sun_path) + path.size();
+    } else {
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path.c_str());
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), addrlen) < 0) {
         perror("bind(uds)");
         close(fd);
         return -1;
@@ -100,6 +127,75 @@ int create_uds_listener(const std::string& path) {
     return fd;
 }
 
+int connect_tcp(const std::string& host, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) <= 0 ||
+            connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Move everything from one socket to another through a pipe with splice(),
+// so the payload never passes through user space.  Returns on EOF or error,
+// and shuts both sockets down so the opposite direction ends too.
+void splice_one_way(int from, int to) {
+    int p[2];
+    if (pipe2(p, O_CLOEXEC) < 0) {
+        perror("pipe2");
+        shutdown(to, SHUT_RDWR);
+        shutdown(from, SHUT_RDWR);
+        return;
+    }
+
+    while (!g_stop) {
+        ssize_t n = splice(from, nullptr, p[1], nullptr, 1 << 16, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        while (n > 0) {
+            ssize_t w = splice(p[0], nullptr, to, nullptr, n, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) {
+                n = -1;
+                break;
+            }
+            n -= w;
+        }
+        if (n < 0) break;
+    }
+
+    close(p[0]);
+    close(p[1]);
+    shutdown(to, SHUT_RDWR);
+    shutdown(from, SHUT_RDWR);
+}
+
+// Relay one socket client to a fresh upstream connection, both directions
+void relay_client(int fd, const std::string& host, int port) {
+    int up = connect_tcp(host, port);
+    if (up < 0) {
+        std::cerr << "[relay] unable to connect to " << host << ":" << port << std::endl;
+        close(fd);
+        return;
+    }
+
+    std::cout << "[relay] client connected to " << host << ":" << port << std::endl;
+
+    std::thread down(splice_one_way, up, fd);
+    splice_one_way(fd, up);
+    down.join();
+
+    close(up);
+    close(fd);
+    std::cout << "[relay] client disconnected" << std::endl;
+}
+
 int create_tcp_listener(int port) {
     int fd = socket(AF_INET, SOCK_STREAM, 0);
     if (fd < 0) {
@@ -135,7 +231,7 @@ int main(int argc, char* argv[]) {
             << "\"sourcetype\":\"cell\","
             << "\"description\":\"Cellular capture (Android feeder)\","
             << "\"preferred_name\":\"cell\","
-            << "\"default_source\":\"uds:" << args.socket_path << "\","
+            << "\"default_source\":\"uds://" << args.socket_path << "\","
             << "\"supports_local\":true,"
             << "\"supports_remote\":true,"
             << "\"options\":["
@@ -143,7 +239,7 @@ int main(int argc, char* argv[]) {
                     << "\"name\":\"socket\","
                     << "\"type\":\"string\","
                     << "\"default\":\"" << args.socket_path << "\","
-                    << "\"description\":\"UNIX domain socket path\""
+                    << "\"description\":\"UNIX domain socket path, or @name for the abstract namespace\""
                 << "},"
                 << "{"
                     << "\"name\":\"enable_tcp\","
@@ -156,6 +252,12 @@ int main(int argc, char* argv[]) {
                     << "\"type\":\"int\","
                     << "\"default\":" << args.tcp_port << ","
                     << "\"description\":\"TCP port when enable_tcp is true\""
+                << "},"
+                << "{"
+                    << "\"name\":\"relay\","
+                    << "\"type\":\"string\","
+                    << "\"default\":\"\","
+                    << "\"description\":\"HOST:PORT to splice each socket client to (phone stream)\""
                 << "}"
             << "]"
             << "}\n";
@@ -164,6 +266,8 @@ int main(int argc, char* argv[]) {
 
     std::signal(SIGINT, [](int) { g_stop = 1; });
     std::signal(SIGTERM, [](int) { g_stop = 1; });
+    // A relay peer going away must fail the splice, not kill the daemon
+    std::signal(SIGPIPE, SIG_IGN);
 
     int uds_fd = create_uds_listener(args.socket_path);
     if (uds_fd < 0) return 1;
@@ -177,6 +281,10 @@ int main(int argc, char* argv[]) {
     }
 
     std::cout << "Listening on UDS: " << args.socket_path << std::endl;
+    if (!args.relay_host.empty()) {
+        std::cout << "Relaying socket clients to " << args.relay_host << ":"
+                  << args.relay_port << std::endl;
+    }
     if (args.enable_tcp) {
         std::cout << "TCP listener enabled on port " << args.tcp_port << std::endl;
     }
@@ -200,7 +308,9 @@ int main(int argc, char* argv[]) {
         if (rv == 0) continue;
         if (FD_ISSET(uds_fd, &rfds)) {
             int c = accept(uds_fd, nullptr, nullptr);
-            if (c >= 0) {
+            if (c >= 0 && !args.relay_host.empty()) {
+                std::thread(relay_client, c, args.relay_host, args.relay_port).detach();
+            } else if (c >= 0) {
                 std::thread(handle_client, c, "uds").detach();
                 std::cout << "[uds] client connected" << std::endl;
             }
@@ -222,7 +332,7 @@ int main(int argc, char* argv[]) {
 
     if (uds_fd >= 0) close(uds_fd);
     if (tcp_fd >= 0) close(tcp_fd);
-    unlink(args.socket_path.c_str());
+    if (!is_abstract(args.socket_path)) unlink(args.socket_path.c_str());
     std::cout << "Shutting down" << std::endl;
     return 0;
 }
@@ -173,11 +173,15 @@ for serial in "${SERIALS[@]}"; do
     echo "[!] Failed adb forward for ${serial} tcp:${port}->tcp:8765; skipping device" >&2
     continue
   fi
-  echo "source=tcp://127.0.0.1:${port}:name=cell-${serial},type=cell" >> "${tmp_out}"
+  gps_opt=""
   if [[ ${FORWARD_GPS} -eq 1 && ${idx} -eq 0 ]]; then
     echo "[*] ${serial} (GPS) -> tcp:${GPS_PORT}"
-    "${ADB_BIN}" -s "${serial}" forward "tcp:${GPS_PORT}" "tcp:8766" || true
+    # The helper reads this phone's NMEA to position its cell frames
+    if "${ADB_BIN}" -s "${serial}" forward "tcp:${GPS_PORT}" "tcp:8766"; then
+      gps_opt=",gps=${GPS_PORT}"
+    fi
   fi
+  echo "source=tcp://127.0.0.1:${port}:name=cell-${serial},type=cell${gps_opt}" >> "${tmp_out}"
   idx=$((idx + 1))
 done
 
@@ -0,0 +1,266 @@
+/*
+ * Per PLMN / band / RAT aggregate counters; see cell_aggregate.h
+ */
+
+#include "cell_aggregate.h"
+
+#include <cmath>
+#include <cstdlib>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+    // Probe limit; keeps a full or clustered table from costing more than this
+    constexpr unsigned int max_probe = 16;
+
+    uint64_t mix64(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    unsigned int parse_code(const std::string& s) {
+        if (s.empty() || s.size() > 3)
+            return 0;
+        for (auto c : s)
+            if (c < '0' || c > '9')
+                return 0;
+        return static_cast<unsigned int>(std::atoi(s.c_str()));
+    }
+}
+
+cell_aggregate_table::cell_aggregate_table(unsigned int capacity) :
+    capacity{capacity ? capacity : 512},
+    slots{new slot[this->capacity]} { }
+
+cell_aggregate_table::rat_type cell_aggregate_table::rat_from_string(const std::string& rat) {
+    if (rat.empty())
+        return rat_unknown;
+    if (rat == "LTE")
+        return rat_lte;
+    if (rat == "NR")
+        return rat_nr;
+    if (rat == "WCDMA")
+        return rat_wcdma;
+    if (rat == "GSM")
+        return rat_gsm;
+    return rat_other;
+}
+
+const char *cell_aggregate_table::rat_to_string(rat_type rat) {
+    switch (rat) {
+        case rat_gsm:
+            return "GSM";
+        case rat_wcdma:
+            return "WCDMA";
+        case rat_lte:
+            return "LTE";
+        case rat_nr:
+            return "NR";
+        case rat_other:
+            return "other";
+        default:
+            return "";
+    }
+}
+
+uint64_t cell_aggregate_table::make_key(const std::string& mcc, const std::string& mnc,
+        rat_type rat, int band) {
+    // Two- and three-digit MNCs are distinct ("01" vs "001")
+    uint64_t mnc_enc = parse_code(mnc) + (mnc.size() == 3 ? 1000 : 0);
+    uint64_t band_enc = band > 0 && band < 0xFFFF ? static_cast<uint64_t>(band) : 0;
+
+    return (1ULL << 63) |
+        (static_cast<uint64_t>(rat) << 48) |
+        (static_cast<uint64_t>(parse_code(mcc)) << 32) |
+        (mnc_enc << 16) |
+        band_enc;
+}
+
+cell_aggregate_table::slot *cell_aggregate_table::find_slot(uint64_t key, bool create) {
+    auto start = mix64(key) % capacity;
+
+    for (unsigned int i = 0; i < max_probe && i < capacity; i++) {
+        auto& s = slots[(start + i) % capacity];
+        auto k = s.key.load(std::memory_order_acquire);
+
+        if (k == key)
+            return &s;
+
+        if (k == 0) {
+            if (!create)
+                return nullptr;
+
+            uint64_t expected = 0;
+            if (s.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel))
+                return &s;
+
+            // Lost the race; the winner may have claimed it for us
+            if (expected == key)
+                return &s;
+        }
+    }
+
+    return nullptr;
+}
+
+void cell_aggregate_table::observe(uint64_t key, uint64_t cell_hash, bool new_cell,
+        bool has_signal, int signal_dbm, uint64_t ts_sec) {
+    auto s = find_slot(key, true);
+    if (s == nullptr) {
+        overflow_count.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    s->observations.fetch_add(1, std::memory_order_relaxed);
+    if (new_cell)
+        s->distinct_cells.fetch_add(1, std::memory_order_relaxed);
+
+    // Epochs start at 1 so a zeroed bucket is never mistaken for a live one
+    uint64_t epoch = ts_sec / bucket_secs + 1;
+    auto& b = s->buckets[epoch % num_buckets];
+
+    auto cur = b.epoch.load(std::memory_order_acquire);
+    if (cur != epoch) {
+        if (cur > epoch)
+            return;     // stale timestamp for an already recycled bucket
+
+        if (b.epoch.compare_exchange_strong(cur, epoch, std::memory_order_acq_rel)) {
+            b.observations.store(0, std::memory_order_relaxed);
+            for (auto& h : b.hist)
+                h.store(0, std::memory_order_relaxed);
+            for (auto& r : b.hll)
+                r.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    b.observations.fetch_add(1, std::memory_order_relaxed);
+
+    if (has_signal) {
+        int bin = (signal_dbm - hist_floor_dbm) / hist_step_db;
+        if (signal_dbm < hist_floor_dbm)
+            bin = 0;
+        if (bin < 0)
+            bin = 0;
+        if (bin >= static_cast<int>(hist_bins))
+            bin = hist_bins - 1;
+        b.hist[bin].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // HyperLogLog: top bits pick the register, rank of the rest is stored max
+    auto h = mix64(cell_hash);
+    auto reg = h >> (64 - hll_bits);
+    auto rest = (h << hll_bits) | (1ULL << (hll_bits - 1));
+    uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+
+    auto& r = b.hll[reg];
+    auto old = r.load(std::memory_order_relaxed);
+    while (old < rank && !r.compare_exchange_weak(old, rank, std::memory_order_relaxed))
+        ;
+}
+
+std::string cell_aggregate_table::dump(uint64_t now_sec, unsigned int window_secs,
+        const std::string& f_mcc, const std::string& f_mnc,
+        const std::string& f_rat, int f_band) const {
+    if (window_secs == 0 || window_secs > bucket_secs * num_buckets)
+        window_secs = bucket_secs * num_buckets;
+
+    uint64_t now_epoch = now_sec / bucket_secs + 1;
+    uint64_t span = (window_secs + bucket_secs - 1) / bucket_secs;
+
+    uint64_t f_key = 0, f_mask = 0;
+    if (!f_rat.empty()) {
+        f_key |= static_cast<uint64_t>(rat_from_string(f_rat)) << 48;
+        f_mask |= 0xFFULL << 48;
+    }
+    if (!f_mcc.empty()) {
+        f_key |= static_cast<uint64_t>(parse_code(f_mcc)) << 32;
+        f_mask |= 0xFFFFULL << 32;
+    }
+    if (!f_mnc.empty()) {
+        f_key |= static_cast<uint64_t>(parse_code(f_mnc) + (f_mnc.size() == 3 ? 1000 : 0)) << 16;
+        f_mask |= 0xFFFFULL << 16;
+    }
+    if (f_band > 0) {
+        f_key |= static_cast<uint64_t>(f_band);
+        f_mask |= 0xFFFFULL;
+    }
+
+    nlohmann::json groups = nlohmann::json::array();
+
+    for (unsigned int i = 0; i < capacity; i++) {
+        const auto& s = slots[i];
+        auto key = s.key.load(std::memory_order_acquire);
+        if (key == 0 || (key & f_mask) != f_key)
+            continue;
+
+        uint64_t win_obs = 0;
+        std::array<uint64_t, hist_bins> hist{};
+        std::array<uint8_t, hll_registers> regs{};
+
+        for (const auto& b : s.buckets) {
+            auto e = b.epoch.load(std::memory_order_acquire);
+            if (e == 0 || e > now_epoch || now_epoch - e >= span)
+                continue;
+
+            win_obs += b.observations.load(std::memory_order_relaxed);
+            for (unsigned int h = 0; h < hist_bins; h++)
+                hist[h] += b.hist[h].load(std::memory_order_relaxed);
+            for (unsigned int r = 0; r < hll_registers; r++)
+                regs[r] = std::max(regs[r], b.hll[r].load(std::memory_order_relaxed));
+        }
+
+        double sum = 0;
+        unsigned int zeros = 0;
+        for (auto r : regs) {
+            sum += std::ldexp(1.0, -static_cast<int>(r));
+            if (r == 0)
+                zeros++;
+        }
+        double m = hll_registers;
+        double est = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+        if (est <= 2.5 * m && zeros > 0)
+            est = m * std::log(m / zeros);
+
+        auto rat = static_cast<rat_type>((key >> 48) & 0xFF);
+        auto mcc = (key >> 32) & 0xFFFF;
+        auto mnc_enc = (key >> 16) & 0xFFFF;
+        auto band = key & 0xFFFF;
+
+        char mcc_s[8], mnc_s[8];
+        snprintf(mcc_s, sizeof(mcc_s), "%03u", static_cast<unsigned int>(mcc));
+        if (mnc_enc >= 1000)
+            snprintf(mnc_s, sizeof(mnc_s), "%03u", static_cast<unsigned int>(mnc_enc - 1000));
+        else
+            snprintf(mnc_s, sizeof(mnc_s), "%02u", static_cast<unsigned int>(mnc_enc));
+
+        groups.push_back({
+                {"mcc", mcc_s},
+                {"mnc", mnc_s},
+                {"rat", rat_to_string(rat)},
+                {"band", band ? nlohmann::json(band) : nlohmann::json()},
+                {"observations", s.observations.load(std::memory_order_relaxed)},
+                {"distinct_cells", s.distinct_cells.load(std::memory_order_relaxed)},
+                {"window_observations", win_obs},
+                {"window_distinct_cells", win_obs ? std::llround(est) : 0},
+                {"window_signal_hist", hist},
+                });
+    }
+
+    std::vector<int> hist_edges;
+    for (unsigned int h = 1; h < hist_bins; h++)
+        hist_edges.push_back(hist_floor_dbm + static_cast<int>(h) * hist_step_db);
+
+    nlohmann::json out = {
+        {"ts", now_sec},
+        {"window_secs", span * bucket_secs},
+        {"signal_hist_edges_dbm", hist_edges},
+        {"overflow", overflow()},
+        {"groups", std::move(groups)},
+    };
+
+    return out.dump();
+}
@@ -0,0 +1,87 @@
+/*
+ * Per PLMN / band / RAT aggregate counters
+ *
+ * Updated from the packet handler without taking any locks: slots live in a
+ * fixed open-addressed table claimed by CAS, and every counter is a relaxed
+ * atomic.  Each slot keeps all-time totals plus a ring of time buckets
+ * covering the last hour; a bucket holds an observation count, a coarse
+ * signal histogram, and a small HyperLogLog sketch so distinct cells over any
+ * window can be estimated by merging buckets at query time.
+ *
+ * Per-packet cost is a hash, a short bounded probe and a few atomic ops,
+ * independent of how many devices exist.  A bucket that is being recycled
+ * while another thread writes to it may lose a count; that is accepted.
+ */
+
+#ifndef __CELL_AGGREGATE_H__
+#define __CELL_AGGREGATE_H__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class cell_aggregate_table {
+public:
+    static constexpr unsigned int bucket_secs = 300;
+    static constexpr unsigned int num_buckets = 12;
+    static constexpr unsigned int hll_bits = 7;
+    static constexpr unsigned int hll_registers = 1 << hll_bits;
+
+    // 10 dB wide bins from -140; first and last bins are open-ended
+    static constexpr int hist_floor_dbm = -140;
+    static constexpr int hist_step_db = 10;
+    static constexpr unsigned int hist_bins = 12;
+
+    enum rat_type : uint8_t {
+        rat_unknown = 0, rat_gsm = 1, rat_wcdma = 2, rat_lte = 3, rat_nr = 4, rat_other = 7,
+    };
+
+    explicit cell_aggregate_table(unsigned int capacity = 512);
+
+    static rat_type rat_from_string(const std::string& rat);
+    static const char *rat_to_string(rat_type rat);
+
+    // Pack a PLMN/band/RAT tuple into a non-zero table key
+    static uint64_t make_key(const std::string& mcc, const std::string& mnc,
+            rat_type rat, int band);
+
+    // Record one observation.  cell_hash identifies the cell for the distinct
+    // count; new_cell marks the first observation of that cell this run.
+    void observe(uint64_t key, uint64_t cell_hash, bool new_cell,
+            bool has_signal, int signal_dbm, uint64_t ts_sec);
+
+    // Observations dropped because the table was full
+    uint64_t overflow() const { return overflow_count.load(std::memory_order_relaxed); }
+
+    // Serialize every populated slot, aggregating buckets from the last
+    // window_secs (capped to the ring length) relative to now_sec.  Optional
+    // filters match mcc/mnc/rat/band exactly when non-empty / non-zero.
+    std::string dump(uint64_t now_sec, unsigned int window_secs,
+            const std::string& f_mcc, const std::string& f_mnc,
+            const std::string& f_rat, int f_band) const;
+
+protected:
+    struct bucket {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<uint32_t> observations{0};
+        std::array<std::atomic<uint32_t>, hist_bins> hist{};
+        std::array<std::atomic<uint8_t>, hll_registers> hll{};
+    };
+
+    struct slot {
+        std::atomic<uint64_t> key{0};
+        std::atomic<uint64_t> observations{0};
+        std::atomic<uint64_t> distinct_cells{0};
+        std::array<bucket, num_buckets> buckets;
+    };
+
+    slot *find_slot(uint64_t key, bool create);
+
+    unsigned int capacity;
+    std::unique_ptr<slot[]> slots;
+    std::atomic<uint64_t> overflow_count{0};
+};
+
+#endif
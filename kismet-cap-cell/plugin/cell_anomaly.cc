@@ -0,0 +1,186 @@
+/*
+ * Streaming rogue-cell / anomaly detector; see cell_anomaly.h
+ */
+
+#include "cell_anomaly.h"
+#include "cell_aggregate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include <fmt.h>
+
+namespace {
+    // Weight of each new-cell signal sample once past warmup
+    constexpr double signal_alpha = 0.05;
+
+    // Without positions, one source hearing both CIDs this close together
+    // counts as the same place
+    constexpr uint64_t same_place_secs = 10;
+
+    double distance_m(double lat1, double lon1, double lat2, double lon2) {
+        // Equirectangular; plenty at cell distances
+        double x = (lon2 - lon1) * M_PI / 180.0 * std::cos((lat1 + lat2) / 2 * M_PI / 180.0);
+        double y = (lat2 - lat1) * M_PI / 180.0;
+        return std::sqrt(x * x + y * y) * 6371000.0;
+    }
+
+    uint64_t mix64(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+}
+
+cell_anomaly_detector::cell_anomaly_detector() :
+    cell_anomaly_detector(config{}) { }
+
+cell_anomaly_detector::cell_anomaly_detector(const config& conf) :
+    conf{conf} { }
+
+const char *cell_anomaly_detector::type_name(anomaly_type t) {
+    switch (t) {
+        case strong_new_cell:
+            return "strong_new_cell";
+        case tac_change:
+            return "tac_change";
+        case pci_collision:
+            return "pci_collision";
+        case rat_downgrade:
+            return "rat_downgrade";
+    }
+    return "";
+}
+
+bool cell_anomaly_detector::is_legacy(uint8_t rat) {
+    return rat == cell_aggregate_table::rat_gsm || rat == cell_aggregate_table::rat_wcdma;
+}
+
+bool cell_anomaly_detector::is_modern(uint8_t rat) {
+    return rat == cell_aggregate_table::rat_lte || rat == cell_aggregate_table::rat_nr;
+}
+
+bool cell_anomaly_detector::pci_nearby(const pci_state& ps, const observation& obs,
+        uint64_t source) const {
+    if (ps.has_position && obs.has_position)
+        return distance_m(ps.lat, ps.lon, obs.lat, obs.lon) <= conf.collision_distance_m;
+    return ps.source == source && obs.ts_sec < ps.last_seen + same_place_secs;
+}
+
+void cell_anomaly_detector::observe(const std::string& source, const observation& obs,
+        std::vector<anomaly>& out) {
+    auto rat_name = cell_aggregate_table::rat_to_string(
+            static_cast<cell_aggregate_table::rat_type>(obs.rat));
+    auto source_hash = static_cast<uint64_t>(std::hash<std::string>{}(source));
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    // Cell identity excludes TAC so a TAC move shows up as a change
+    auto cell_key = mix64(obs.plmn_rat ^ mix64(obs.cid));
+    auto ci = cells.find(cell_key);
+
+    if (ci == cells.end()) {
+        if (obs.has_signal) {
+            auto& st = new_cell_signal[obs.rat & 7];
+            if (st.n >= conf.strong_warmup && obs.signal_dbm >= conf.strong_floor_dbm &&
+                    obs.signal_dbm > st.mean + conf.strong_sigma * std::sqrt(st.var)) {
+                out.push_back({strong_new_cell,
+                        fmt::format("New {} cell CID {} at {} dBm, typical new cells "
+                            "arrive at {:.0f} +/- {:.0f} dBm", rat_name, obs.cid,
+                            obs.signal_dbm, st.mean, std::sqrt(st.var))});
+                type_counts[strong_new_cell]++;
+            }
+
+            // Welford during warmup, then an EWMA so the baseline follows the area
+            double x = obs.signal_dbm;
+            st.n++;
+            if (st.n <= conf.strong_warmup) {
+                double d = x - st.mean;
+                st.mean += d / st.n;
+                st.var += (d * (x - st.mean) - st.var) / st.n;
+            } else {
+                double d = x - st.mean;
+                st.mean += signal_alpha * d;
+                st.var = (1 - signal_alpha) * (st.var + signal_alpha * d * d);
+            }
+        }
+
+        make_room(cells, conf.max_cells);
+        ci = cells.emplace(cell_key, cell_state{}).first;
+        ci->second.tac = obs.tac;
+        ci->second.has_tac = obs.has_tac;
+    } else if (obs.has_tac) {
+        auto& cs = ci->second;
+        if (cs.has_tac && cs.tac != obs.tac) {
+            out.push_back({tac_change,
+                    fmt::format("{} CID {} moved from TAC/LAC {} to {}", rat_name,
+                        obs.cid, cs.tac, obs.tac)});
+            type_counts[tac_change]++;
+        }
+        cs.tac = obs.tac;
+        cs.has_tac = true;
+    }
+
+    if (obs.has_pci) {
+        auto pci_key = mix64(obs.plmn_rat ^ mix64((static_cast<uint64_t>(obs.arfcn) << 32) | obs.pci));
+        auto pi = pcis.find(pci_key);
+        if (pi == pcis.end()) {
+            make_room(pcis, conf.max_cells);
+            pi = pcis.emplace(pci_key, pci_state{obs.cid, obs.ts_sec, false}).first;
+        } else {
+            auto& ps = pi->second;
+            if (ps.cid != obs.cid) {
+                bool recent = obs.ts_sec < ps.last_seen + conf.collision_window_secs &&
+                    pci_nearby(ps, obs, source_hash);
+                if (recent && !ps.reported) {
+                    out.push_back({pci_collision,
+                            fmt::format("{} PCI {} on ARFCN {} used by CID {} and CID {} "
+                                "within {} s", rat_name, obs.pci, obs.arfcn, ps.cid,
+                                obs.cid, obs.ts_sec - ps.last_seen)});
+                    type_counts[pci_collision]++;
+                    ps.reported = true;
+                } else if (!recent) {
+                    ps.reported = false;
+                }
+                ps.cid = obs.cid;
+            }
+            ps.last_seen = std::max(ps.last_seen, obs.ts_sec);
+        }
+
+        auto& ps = pi->second;
+        ps.source = source_hash;
+        ps.has_position = obs.has_position;
+        ps.lat = static_cast<float>(obs.lat);
+        ps.lon = static_cast<float>(obs.lon);
+    }
+
+    if (obs.serving) {
+        auto si = sources.find(source);
+        if (si == sources.end()) {
+            make_room(sources, conf.max_sources);
+            si = sources.emplace(source, source_state{}).first;
+        }
+        auto& ss = si->second;
+        if (ss.last_seen != 0 && is_modern(ss.rat) && is_legacy(obs.rat) &&
+                obs.ts_sec < ss.last_seen + conf.downgrade_window_secs) {
+            out.push_back({rat_downgrade,
+                    fmt::format("Serving cell dropped from {} CID {} to {} CID {}",
+                        cell_aggregate_table::rat_to_string(
+                            static_cast<cell_aggregate_table::rat_type>(ss.rat)),
+                        ss.cid, rat_name, obs.cid)});
+            type_counts[rat_downgrade]++;
+        }
+        ss.rat = obs.rat;
+        ss.cid = obs.cid;
+        ss.last_seen = obs.ts_sec;
+    }
+}
+
+std::array<uint64_t, cell_anomaly_detector::num_types> cell_anomaly_detector::counts() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return type_counts;
+}
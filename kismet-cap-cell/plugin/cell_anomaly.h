@@ -0,0 +1,148 @@
+/*
+ * Streaming rogue-cell / anomaly detector
+ *
+ * Runs inline on every cell observation with a fixed amount of work: a
+ * handful of hash lookups into tables whose entries are small fixed-size
+ * structs.  Four conditions are checked:
+ *
+ *  - strong_new_cell: a cell seen for the first time whose signal is far above
+ *    what new cells of the same RAT normally arrive with (running mean and
+ *    variance, EWMA), and above an absolute floor
+ *  - tac_change: a cell identity (PLMN, RAT, CID) that reappears in a
+ *    different TAC/LAC
+ *  - pci_collision: a PCI/ARFCN pair already owned by a different CID heard
+ *    within the collision window and close by; networks plan PCIs so
+ *    neighbours differ, but reuse them between sites a few km apart.  Close
+ *    by means the two phone positions are within the collision distance, or,
+ *    without positions, the same source heard both within a few seconds
+ *  - rat_downgrade: the serving cell of a source dropping from LTE/NR to
+ *    GSM/WCDMA within the downgrade window
+ *
+ * Each table is capped; when full an arbitrary entry is evicted, so memory is
+ * bounded regardless of drive length.  Each anomaly is reported once per
+ * change, not on every frame that exhibits it.
+ */
+
+#ifndef __CELL_ANOMALY_H__
+#define __CELL_ANOMALY_H__
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class cell_anomaly_detector {
+public:
+    enum anomaly_type : uint8_t {
+        strong_new_cell = 0,
+        tac_change = 1,
+        pci_collision = 2,
+        rat_downgrade = 3,
+    };
+    static constexpr unsigned int num_types = 4;
+
+    struct config {
+        // New cells must beat the RAT mean by this many standard deviations...
+        double strong_sigma = 3.0;
+        // ...and be at least this strong
+        int strong_floor_dbm = -70;
+        // New-cell signal samples needed before the statistics are trusted
+        unsigned int strong_warmup = 30;
+        unsigned int collision_window_secs = 300;
+        double collision_distance_m = 2000;
+        unsigned int downgrade_window_secs = 60;
+        size_t max_cells = 65536;
+        size_t max_sources = 256;
+    };
+
+    // One observation, already reduced to numeric identity.  rat uses the
+    // cell_aggregate_table::rat_type values; plmn_rat is any key that is
+    // unique per PLMN + RAT (cell_aggregate_table::make_key with band 0).
+    struct observation {
+        uint64_t plmn_rat = 0;
+        uint8_t rat = 0;
+        uint64_t cid = 0;
+        bool has_tac = false;
+        uint32_t tac = 0;
+        bool has_pci = false;
+        uint32_t pci = 0;
+        uint32_t arfcn = 0;
+        bool has_signal = false;
+        int signal_dbm = 0;
+        bool serving = false;
+        uint64_t ts_sec = 0;
+        // Phone position when the cell was heard
+        bool has_position = false;
+        double lat = 0, lon = 0;
+    };
+
+    struct anomaly {
+        anomaly_type type;
+        std::string text;
+    };
+
+    cell_anomaly_detector();
+    explicit cell_anomaly_detector(const config& conf);
+
+    static const char *type_name(anomaly_type t);
+
+    // Check one observation from source and update the state.  Detected
+    // anomalies are appended to out, which is left untouched otherwise.
+    void observe(const std::string& source, const observation& obs,
+            std::vector<anomaly>& out);
+
+    std::array<uint64_t, num_types> counts() const;
+
+protected:
+    struct cell_state {
+        uint32_t tac = 0;
+        bool has_tac = false;
+    };
+
+    struct pci_state {
+        uint64_t cid = 0;
+        uint64_t last_seen = 0;
+        bool reported = false;
+        // Where and by whom the owning CID was last heard
+        bool has_position = false;
+        float lat = 0, lon = 0;
+        uint64_t source = 0;
+    };
+
+    struct source_state {
+        uint8_t rat = 0;
+        uint64_t cid = 0;
+        uint64_t last_seen = 0;
+    };
+
+    struct signal_stats {
+        double mean = 0;
+        double var = 0;
+        uint64_t n = 0;
+    };
+
+    template<typename M>
+    void make_room(M& m, size_t cap) {
+        if (m.size() >= cap)
+            m.erase(m.begin());
+    }
+
+    // Two sightings of a PCI close enough that reuse can't explain them
+    bool pci_nearby(const pci_state& ps, const observation& obs, uint64_t source) const;
+
+    static bool is_legacy(uint8_t rat);
+    static bool is_modern(uint8_t rat);
+
+    config conf;
+
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, cell_state> cells;
+    std::unordered_map<uint64_t, pci_state> pcis;
+    std::unordered_map<std::string, source_state> sources;
+    std::array<signal_stats, 8> new_cell_signal;
+    std::array<uint64_t, num_types> type_counts{};
+};
+
+#endif
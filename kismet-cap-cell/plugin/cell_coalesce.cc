@@ -0,0 +1,84 @@
+/*
+ * Cross-source observation coalescing; see cell_coalesce.h
+ */
+
+#include "cell_coalesce.h"
+
+#include <algorithm>
+#include <iterator>
+
+cell_coalescer::cell_coalescer(unsigned int in_window_ms, unsigned int idle_secs) :
+    window_ms(in_window_ms),
+    // Per-source state has to outlive a window or there is nothing to merge
+    idle_ms(std::max<uint64_t>(idle_secs * 1000ULL, in_window_ms * 10ULL)) { }
+
+bool cell_coalescer::observe(const std::string& key, const std::string& source,
+        bool has_signal, int signal_dbm, uint64_t ts_ms) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    if (ts_ms >= next_expire_ms)
+        expire_locked(ts_ms);
+
+    auto& w = cells[key];
+
+    // A new cell, the window ran out, or the clock went backwards past it
+    bool opens = w.last_ms == 0 || ts_ms >= w.start_ms + window_ms ||
+        ts_ms + window_ms <= w.start_ms;
+    if (opens)
+        w.start_ms = ts_ms;
+    w.last_ms = std::max(w.last_ms, ts_ms);
+
+    auto si = std::find_if(w.sources.begin(), w.sources.end(),
+            [&source](const source_vec::value_type& s) { return s.first == source; });
+    if (si == w.sources.end()) {
+        w.sources.emplace_back(source, source_signal());
+        si = std::prev(w.sources.end());
+    }
+
+    auto& ss = si->second;
+    ss.last_ms = ts_ms;
+    if (has_signal) {
+        if (!ss.has_signal || signal_dbm > ss.best_signal)
+            ss.best_signal = signal_dbm;
+        ss.last_signal = signal_dbm;
+        ss.has_signal = true;
+    }
+
+    return opens;
+}
+
+cell_coalescer::source_vec cell_coalescer::sources(const std::string& key) const {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    auto ci = cells.find(key);
+    if (ci == cells.end())
+        return {};
+    return ci->second.sources;
+}
+
+size_t cell_coalescer::size() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return cells.size();
+}
+
+void cell_coalescer::expire_locked(uint64_t now_ms) {
+    next_expire_ms = now_ms + idle_ms;
+    if (now_ms < idle_ms)
+        return;
+
+    uint64_t cutoff = now_ms - idle_ms;
+
+    for (auto ci = cells.begin(); ci != cells.end(); ) {
+        if (ci->second.last_ms < cutoff) {
+            ci = cells.erase(ci);
+            continue;
+        }
+
+        // A phone that stopped hearing the cell drops out of its list
+        auto& srcs = ci->second.sources;
+        srcs.erase(std::remove_if(srcs.begin(), srcs.end(),
+                    [cutoff](const source_vec::value_type& s) { return s.second.last_ms < cutoff; }),
+                srcs.end());
+        ++ci;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Cross-source observation coalescing for the cell PHY
+ *
+ * Several phones in one vehicle report the same serving and neighbour cells
+ * within milliseconds of each other.  The first observation of a cell key
+ * opens a window of window_ms; it is applied to the device tracker as usual,
+ * and every further observation of that key inside the window, from any
+ * source, is only folded into the per-source signal table here.  Device,
+ * estimator and summary work is then done once per window rather than once
+ * per phone.
+ *
+ * Each cell keeps the last and best signal per source until the cell has not
+ * been heard for idle_secs, so the next applied observation can report what
+ * every phone saw.
+ */
+
+#ifndef __CELL_COALESCE_H__
+#define __CELL_COALESCE_H__
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class cell_coalescer {
+public:
+    struct source_signal {
+        bool has_signal = false;
+        int16_t last_signal = 0;
+        int16_t best_signal = 0;
+        uint64_t last_ms = 0;
+    };
+
+    using source_vec = std::vector<std::pair<std::string, source_signal>>;
+
+    cell_coalescer(unsigned int window_ms = 500, unsigned int idle_secs = 60);
+
+    cell_coalescer(const cell_coalescer&) = delete;
+    cell_coalescer& operator=(const cell_coalescer&) = delete;
+
+    // Record one observation of key from source.  Returns true if it opens
+    // a new window and should be applied, false if it falls inside the
+    // current one.
+    bool observe(const std::string& key, const std::string& source,
+            bool has_signal, int signal_dbm, uint64_t ts_ms);
+
+    // Per-source signals for key, in the order sources were first seen
+    source_vec sources(const std::string& key) const;
+
+    // Cells with an open window or recent per-source state
+    size_t size() const;
+
+protected:
+    struct cell_window {
+        uint64_t start_ms = 0;
+        uint64_t last_ms = 0;
+        source_vec sources;     // a handful of phones; a vector beats a map
+    };
+
+    void expire_locked(uint64_t now_ms);
+
+    const uint64_t window_ms;
+    const uint64_t idle_ms;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, cell_window> cells;
+    uint64_t next_expire_ms = 0;
+};
+
+#endif
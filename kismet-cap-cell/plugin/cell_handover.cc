@@ -0,0 +1,188 @@
+/*
+ * Per-source serving cell handover tracker; see cell_handover.h
+ */
+
+#include "cell_handover.h"
+#include "cell_aggregate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+    // A serving cell change after this long without serving frames is a
+    // reacquisition (phone unplugged, out of coverage), not a handover
+    constexpr uint64_t max_gap_ms = 60 * 1000;
+
+    void copy_key(char *dst, const std::string& src, size_t len) {
+        auto n = std::min(src.size(), len - 1);
+        memcpy(dst, src.data(), n);
+        memset(dst + n, 0, len - n);
+    }
+
+    std::string key_str(const char *k, size_t len) {
+        return std::string(k, strnlen(k, len));
+    }
+}
+
+cell_handover_tracker::cell_handover_tracker(size_t ring_size, unsigned int pingpong_secs,
+        size_t max_sources) :
+    ring_size{ring_size ? ring_size : 256},
+    pingpong_secs{pingpong_secs},
+    max_sources{max_sources} { }
+
+const cell_handover_tracker::event *cell_handover_tracker::newest(const source_track& st) const {
+    if (st.count == 0)
+        return nullptr;
+    return &st.ring[(st.head + ring_size - 1) % ring_size];
+}
+
+void cell_handover_tracker::observe(const std::string& source, const std::string& key,
+        uint8_t rat, bool has_signal, int signal_dbm, bool has_position, double lat, double lon,
+        uint64_t ts_ms) {
+    char k[key_len];
+    copy_key(k, key, key_len);
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    auto si = sources.find(source);
+    if (si == sources.end()) {
+        if (sources.size() >= max_sources)
+            return;
+        auto st = std::make_unique<source_track>();
+        st->ring.resize(ring_size);
+        si = sources.emplace(source, std::move(st)).first;
+    }
+
+    auto& st = *si->second;
+
+    if (st.has_serving && memcmp(st.serving, k, key_len) != 0 &&
+            ts_ms >= st.last_seen_ms && ts_ms - st.last_seen_ms <= max_gap_ms) {
+        auto prev = newest(st);
+        auto& ev = st.ring[st.head];
+
+        ev.ts_ms = ts_ms;
+        ev.dwell_ms = static_cast<uint32_t>(std::min<uint64_t>(ts_ms - st.serving_since_ms, UINT32_MAX));
+        ev.from_rat = st.serving_rat;
+        ev.to_rat = rat;
+        ev.flags = 0;
+        memcpy(ev.from, st.serving, key_len);
+        memcpy(ev.to, k, key_len);
+
+        ev.signal_before = st.last_signal;
+        if (st.has_signal)
+            ev.flags |= ev_has_before;
+
+        ev.signal_after = has_signal ? static_cast<int16_t>(signal_dbm) : 0;
+        if (has_signal)
+            ev.flags |= ev_has_after;
+
+        ev.lat_e7 = ev.lon_e7 = 0;
+        if (has_position) {
+            ev.lat_e7 = static_cast<int32_t>(std::lround(lat * 1e7));
+            ev.lon_e7 = static_cast<int32_t>(std::lround(lon * 1e7));
+            ev.flags |= ev_has_position;
+        }
+
+        if (prev != nullptr && memcmp(prev->from, k, key_len) == 0 &&
+                memcmp(prev->to, st.serving, key_len) == 0 &&
+                ts_ms - prev->ts_ms <= pingpong_secs * 1000ULL) {
+            ev.flags |= ev_pingpong;
+            st.pingpongs++;
+        }
+
+        st.handovers++;
+        st.total_dwell_ms += ev.dwell_ms;
+
+        st.head = (st.head + 1) % ring_size;
+        if (st.count < ring_size)
+            st.count++;
+    }
+
+    if (!st.has_serving || memcmp(st.serving, k, key_len) != 0) {
+        memcpy(st.serving, k, key_len);
+        st.serving_rat = rat;
+        st.serving_since_ms = ts_ms;
+        st.has_serving = true;
+        st.has_signal = false;
+    }
+
+    st.last_seen_ms = ts_ms;
+    if (has_signal) {
+        st.last_signal = static_cast<int16_t>(signal_dbm);
+        st.has_signal = true;
+    }
+}
+
+std::string cell_handover_tracker::dump(const std::string& source, size_t limit,
+        uint64_t now_ms, unsigned int window_secs) const {
+    auto rat_name = [](uint8_t r) {
+        return cell_aggregate_table::rat_to_string(static_cast<cell_aggregate_table::rat_type>(r));
+    };
+
+    nlohmann::json out = nlohmann::json::array();
+    uint64_t window_ms = window_secs * 1000ULL;
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    for (const auto& si : sources) {
+        if (!source.empty() && si.first != source)
+            continue;
+
+        const auto& st = *si.second;
+
+        uint64_t w_handovers = 0, w_pingpongs = 0;
+        nlohmann::json events = nlohmann::json::array();
+
+        // Newest first
+        for (size_t i = 0; i < st.count; i++) {
+            const auto& ev = st.ring[(st.head + ring_size - 1 - i) % ring_size];
+
+            if (now_ms - ev.ts_ms <= window_ms || ev.ts_ms > now_ms) {
+                w_handovers++;
+                if (ev.flags & ev_pingpong)
+                    w_pingpongs++;
+            }
+
+            if (limit != 0 && events.size() >= limit)
+                continue;
+
+            nlohmann::json e = {
+                {"ts", ev.ts_ms / 1000.0},
+                {"from", key_str(ev.from, key_len)},
+                {"to", key_str(ev.to, key_len)},
+                {"from_rat", rat_name(ev.from_rat)},
+                {"to_rat", rat_name(ev.to_rat)},
+                {"dwell_s", ev.dwell_ms / 1000.0},
+                {"pingpong", (ev.flags & ev_pingpong) != 0},
+            };
+            e["signal_before"] = (ev.flags & ev_has_before) ? nlohmann::json(ev.signal_before) : nlohmann::json();
+            e["signal_after"] = (ev.flags & ev_has_after) ? nlohmann::json(ev.signal_after) : nlohmann::json();
+            if (ev.flags & ev_has_position) {
+                e["lat"] = ev.lat_e7 / 1e7;
+                e["lon"] = ev.lon_e7 / 1e7;
+            }
+            events.push_back(std::move(e));
+        }
+
+        out.push_back({
+                {"source", si.first},
+                {"serving", st.has_serving ? key_str(st.serving, key_len) : ""},
+                {"serving_rat", rat_name(st.serving_rat)},
+                {"serving_since", st.serving_since_ms / 1000.0},
+                {"handovers", st.handovers},
+                {"pingpongs", st.pingpongs},
+                {"pingpong_ratio", st.handovers ? static_cast<double>(st.pingpongs) / st.handovers : 0.0},
+                {"mean_dwell_s", st.handovers ? st.total_dwell_ms / 1000.0 / st.handovers : 0.0},
+                {"window_secs", window_secs},
+                {"window_handovers", w_handovers},
+                {"window_pingpongs", w_pingpongs},
+                {"handovers_per_hour", window_secs ? w_handovers * 3600.0 / window_secs : 0.0},
+                {"events", std::move(events)},
+                });
+    }
+
+    return out.dump();
+}
@@ -0,0 +1,91 @@
+/*
+ * Per-source serving cell handover tracker
+ *
+ * Each capture source (one phone) gets a fixed-size ring of packed handover
+ * events, allocated once when the source is first seen.  A serving cell
+ * frame is compared against the source's current serving cell; a change
+ * records the cells, the signal on the old cell just before and on the new
+ * cell just after, how long the old cell was held, and the phone position.
+ * Cell keys are stored inline so the per-frame path never allocates.
+ *
+ * A ping-pong is a handover back to the cell the previous handover left,
+ * within pingpong_secs of it.
+ */
+
+#ifndef __CELL_HANDOVER_H__
+#define __CELL_HANDOVER_H__
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class cell_handover_tracker {
+public:
+    static constexpr size_t key_len = 32;
+
+    struct event {
+        uint64_t ts_ms;
+        uint32_t dwell_ms;          // time spent on the from cell
+        int32_t lat_e7;
+        int32_t lon_e7;
+        int16_t signal_before;
+        int16_t signal_after;
+        uint8_t from_rat;
+        uint8_t to_rat;
+        uint8_t flags;
+        char from[key_len];
+        char to[key_len];
+    };
+
+    static constexpr uint8_t ev_has_before = 1 << 0;
+    static constexpr uint8_t ev_has_after = 1 << 1;
+    static constexpr uint8_t ev_has_position = 1 << 2;
+    static constexpr uint8_t ev_pingpong = 1 << 3;
+
+    cell_handover_tracker(size_t ring_size = 256, unsigned int pingpong_secs = 10,
+            size_t max_sources = 64);
+
+    // Feed one serving cell observation for source.  rat uses the
+    // cell_aggregate_table::rat_type values.
+    void observe(const std::string& source, const std::string& key, uint8_t rat,
+            bool has_signal, int signal_dbm, bool has_position, double lat, double lon,
+            uint64_t ts_ms);
+
+    // Per-source statistics and the newest limit events (all sources when
+    // source is empty).  Rates are computed over window_secs before now_ms.
+    std::string dump(const std::string& source, size_t limit, uint64_t now_ms,
+            unsigned int window_secs) const;
+
+protected:
+    struct source_track {
+        std::vector<event> ring;    // sized once, never grows
+        size_t head = 0;
+        size_t count = 0;
+
+        char serving[key_len] = {};
+        uint8_t serving_rat = 0;
+        uint64_t serving_since_ms = 0;
+        uint64_t last_seen_ms = 0;
+        bool has_serving = false;
+        bool has_signal = false;
+        int16_t last_signal = 0;
+
+        uint64_t handovers = 0;
+        uint64_t pingpongs = 0;
+        uint64_t total_dwell_ms = 0;
+    };
+
+    const event *newest(const source_track& st) const;
+
+    size_t ring_size;
+    unsigned int pingpong_secs;
+    size_t max_sources;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<source_track>> sources;
+};
+
+#endif
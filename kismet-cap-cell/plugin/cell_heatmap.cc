@@ -0,0 +1,225 @@
+/*
+ * Live coverage heatmap bins; see cell_heatmap.h
+ */
+
+#include "cell_heatmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+    // Web Mercator stops here
+    constexpr double max_lat = 85.05112878;
+
+    uint64_t mix64(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+}
+
+cell_heatmap::cell_heatmap(unsigned int in_zoom, size_t in_max_bins, bool in_cell_layers) :
+    zoom(std::min(in_zoom, 24u)),
+    max_bins(std::max<size_t>(in_max_bins, 1024)),
+    cell_layers(in_cell_layers) { }
+
+size_t cell_heatmap::bin_key_hash::operator()(const bin_key& k) const {
+    return static_cast<size_t>(mix64(k.layer ^ mix64((uint64_t{k.x} << 32) | k.y)));
+}
+
+void cell_heatmap::tile_for(double lat, double lon, unsigned int zoom, uint32_t& x, uint32_t& y) {
+    double n = std::ldexp(1.0, zoom);
+    lat = std::max(-max_lat, std::min(max_lat, lat));
+    double lat_r = lat * M_PI / 180.0;
+
+    double fx = (lon + 180.0) / 360.0 * n;
+    double fy = (1.0 - std::asinh(std::tan(lat_r)) / M_PI) / 2.0 * n;
+
+    x = static_cast<uint32_t>(std::max(0.0, std::min(n - 1, std::floor(fx))));
+    y = static_cast<uint32_t>(std::max(0.0, std::min(n - 1, std::floor(fy))));
+}
+
+void cell_heatmap::observe(uint64_t plmn_layer, uint64_t cell_hash,
+        const std::string& mcc, const std::string& mnc, const std::string& rat,
+        int band, const std::string& cell,
+        double lat, double lon, bool has_signal, int signal_dbm, uint64_t ts_sec) {
+    uint32_t x, y;
+    tile_for(lat, lon, zoom, x, y);
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    update_locked(plmn_layer, x, y, mcc, mnc, rat, band, "", has_signal, signal_dbm, ts_sec);
+
+    // Aggregate keys always have the top bit set; cell layers never do
+    if (cell_layers) {
+        uint64_t cell_layer = cell_hash & ~(1ULL << 63);
+        update_locked(cell_layer ? cell_layer : 1, x, y, mcc, mnc, rat, band, cell,
+                has_signal, signal_dbm, ts_sec);
+    }
+
+    if (bins.size() > max_bins)
+        evict_locked();
+}
+
+void cell_heatmap::update_locked(uint64_t layer, uint32_t x, uint32_t y,
+        const std::string& mcc, const std::string& mnc, const std::string& rat,
+        int band, const std::string& cell,
+        bool has_signal, int signal_dbm, uint64_t ts_sec) {
+    auto bi = bins.try_emplace(bin_key{layer, x, y});
+    auto& b = bi.first->second;
+
+    if (bi.second) {
+        auto li = layers.try_emplace(layer);
+        auto& l = li.first->second;
+        if (li.second) {
+            l.mcc = mcc;
+            l.mnc = mnc;
+            l.rat = rat;
+            l.band = band;
+            l.cell = cell;
+        }
+        l.bins++;
+    }
+
+    b.count++;
+    b.last_sec = static_cast<uint32_t>(ts_sec);
+
+    if (has_signal) {
+        b.signal_count++;
+        b.signal_mean += (signal_dbm - b.signal_mean) / b.signal_count;
+        if (b.signal_count == 1 || signal_dbm > b.signal_max)
+            b.signal_max = static_cast<int16_t>(signal_dbm);
+    }
+}
+
+void cell_heatmap::evict_locked() {
+    // Drop down to three quarters of the limit, coldest bins first
+    size_t target = max_bins - max_bins / 4;
+    if (bins.size() <= target)
+        return;
+
+    std::vector<uint32_t> ages;
+    ages.reserve(bins.size());
+    for (const auto& b : bins)
+        ages.push_back(b.second.last_sec);
+
+    size_t drop = bins.size() - target;
+    std::nth_element(ages.begin(), ages.begin() + (drop - 1), ages.end());
+    uint32_t cutoff = ages[drop - 1];
+
+    for (auto bi = bins.begin(); bi != bins.end() && drop > 0; ) {
+        if (bi->second.last_sec > cutoff) {
+            ++bi;
+            continue;
+        }
+
+        auto li = layers.find(bi->first.layer);
+        if (li != layers.end() && --li->second.bins == 0)
+            layers.erase(li);
+
+        bi = bins.erase(bi);
+        evicted_bins++;
+        drop--;
+    }
+}
+
+std::string cell_heatmap::dump(const filter& flt, uint64_t now_sec) const {
+    uint32_t x_min = 0, x_max = UINT32_MAX, y_min = 0, y_max = UINT32_MAX;
+    bool wraps = false;
+    if (flt.has_bbox) {
+        tile_for(flt.north, flt.west, zoom, x_min, y_min);
+        tile_for(flt.south, flt.east, zoom, x_max, y_max);
+        // A box across the antimeridian
+        wraps = flt.west > flt.east;
+    }
+
+    auto in_bbox = [&](uint32_t x, uint32_t y) {
+        if (y < y_min || y > y_max)
+            return false;
+        return wraps ? (x >= x_min || x <= x_max) : (x >= x_min && x <= x_max);
+    };
+
+    auto layer_match = [&flt](const layer_info& l) {
+        if (!flt.cell.empty())
+            return l.cell == flt.cell;
+        if (!l.cell.empty() && !flt.cells)
+            return false;
+        return (flt.mcc.empty() || l.mcc == flt.mcc) &&
+            (flt.mnc.empty() || l.mnc == flt.mnc) &&
+            (flt.rat.empty() || l.rat == flt.rat) &&
+            (flt.band == 0 || l.band == flt.band);
+    };
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    // Ordered so replies are stable between polls
+    std::map<uint64_t, nlohmann::json> rows;
+
+    for (const auto& bi : bins) {
+        const auto& k = bi.first;
+        const auto& b = bi.second;
+
+        if (b.last_sec < flt.since || b.count < flt.min_count || !in_bbox(k.x, k.y))
+            continue;
+
+        auto li = layers.find(k.layer);
+        if (li == layers.end() || !layer_match(li->second))
+            continue;
+
+        auto& r = rows[k.layer];
+        if (r.is_null())
+            r = nlohmann::json::array();
+
+        // [x, y, count, mean dBm, max dBm, last update]
+        nlohmann::json sig_mean, sig_max;
+        if (b.signal_count > 0) {
+            sig_mean = std::round(b.signal_mean * 10) / 10;
+            sig_max = b.signal_max;
+        }
+        r.push_back({k.x, k.y, b.count, sig_mean, sig_max, b.last_sec});
+    }
+
+    nlohmann::json out_layers = nlohmann::json::array();
+    for (auto& r : rows) {
+        const auto& l = layers.at(r.first);
+        nlohmann::json lj = {
+            {"mcc", l.mcc},
+            {"mnc", l.mnc},
+            {"rat", l.rat},
+            {"band", l.band ? nlohmann::json(l.band) : nlohmann::json()},
+        };
+        if (!l.cell.empty())
+            lj["cell"] = l.cell;
+        lj["bins"] = std::move(r.second);
+        out_layers.push_back(std::move(lj));
+    }
+
+    nlohmann::json out = {
+        {"ts", now_sec},
+        {"zoom", zoom},
+        {"bin_fields", {"x", "y", "count", "signal_mean", "signal_max", "last"}},
+        {"bins_total", bins.size()},
+        {"evicted", evicted_bins},
+        {"layers", std::move(out_layers)},
+    };
+
+    return out.dump();
+}
+
+size_t cell_heatmap::size() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return bins.size();
+}
+
+void cell_heatmap::stats(size_t& held, uint64_t& evicted) const {
+    std::lock_guard<std::mutex> lk(mutex);
+    held = bins.size();
+    evicted = evicted_bins;
+}
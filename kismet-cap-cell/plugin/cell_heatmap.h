@@ -0,0 +1,104 @@
+/*
+ * Live coverage heatmap bins
+ *
+ * Each observation with a phone position lands in one slippy-map tile at a
+ * fixed zoom, once in its PLMN / RAT / band layer and, optionally, once in a
+ * layer of its own cell.  A bin holds the observation count, the running mean
+ * and maximum signal, and when it was last updated; updating one is a hash
+ * lookup and a few arithmetic ops, so coverage maps are available while the
+ * drive is still going instead of being rebuilt from the exports afterwards.
+ *
+ * Memory is bounded by max_bins.  When the table grows past it, the coldest
+ * quarter of the bins (least recently updated) is dropped in one pass, which
+ * keeps the amortized cost per observation constant.  A layer goes away with
+ * its last bin.
+ */
+
+#ifndef __CELL_HEATMAP_H__
+#define __CELL_HEATMAP_H__
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class cell_heatmap {
+public:
+    // Query parameters for dump(); empty / zero fields match anything
+    struct filter {
+        std::string mcc, mnc, rat, cell;
+        int band = 0;
+        bool cells = false;         // include per-cell layers
+        bool has_bbox = false;
+        double west = 0, south = 0, east = 0, north = 0;
+        uint64_t since = 0;         // bins updated at or after this unix time
+        uint32_t min_count = 0;
+    };
+
+    cell_heatmap(unsigned int zoom = 16, size_t max_bins = 200000, bool cell_layers = true);
+
+    cell_heatmap(const cell_heatmap&) = delete;
+    cell_heatmap& operator=(const cell_heatmap&) = delete;
+
+    // Record one positioned observation.  plmn_layer is the aggregate table
+    // key of the cell's PLMN/RAT/band, cell_hash the cell's device hash.
+    void observe(uint64_t plmn_layer, uint64_t cell_hash,
+            const std::string& mcc, const std::string& mnc, const std::string& rat,
+            int band, const std::string& cell,
+            double lat, double lon, bool has_signal, int signal_dbm, uint64_t ts_sec);
+
+    std::string dump(const filter& flt, uint64_t now_sec) const;
+
+    size_t size() const;
+
+    // Bins held and bins dropped so far to stay under max_bins
+    void stats(size_t& held, uint64_t& evicted) const;
+
+    // Tile column / row holding lat, lon at zoom
+    static void tile_for(double lat, double lon, unsigned int zoom, uint32_t& x, uint32_t& y);
+
+protected:
+    struct bin_key {
+        uint64_t layer;
+        uint32_t x, y;
+
+        bool operator==(const bin_key& o) const {
+            return layer == o.layer && x == o.x && y == o.y;
+        }
+    };
+
+    struct bin_key_hash {
+        size_t operator()(const bin_key& k) const;
+    };
+
+    struct bin {
+        uint32_t count = 0;
+        uint32_t signal_count = 0;
+        float signal_mean = 0;
+        int16_t signal_max = 0;
+        uint32_t last_sec = 0;
+    };
+
+    struct layer_info {
+        std::string mcc, mnc, rat, cell;
+        int band = 0;
+        size_t bins = 0;
+    };
+
+    void update_locked(uint64_t layer, uint32_t x, uint32_t y,
+            const std::string& mcc, const std::string& mnc, const std::string& rat,
+            int band, const std::string& cell,
+            bool has_signal, int signal_dbm, uint64_t ts_sec);
+    void evict_locked();
+
+    const unsigned int zoom;
+    const size_t max_bins;
+    const bool cell_layers;
+
+    mutable std::mutex mutex;
+    std::unordered_map<bin_key, bin, bin_key_hash> bins;
+    std::unordered_map<uint64_t, layer_info> layers;
+    uint64_t evicted_bins = 0;
+};
+
+#endif
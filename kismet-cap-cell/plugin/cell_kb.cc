@@ -0,0 +1,350 @@
+/*
+ * Warm-start knowledge base of previously seen cells; see cell_kb.h
+ */
+
+#include "cell_kb.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(cell_kb::header) == 64, "cell_kb header layout changed");
+static_assert(sizeof(cell_kb::record) == 208, "cell_kb record layout changed");
+
+namespace {
+    bool record_less(const cell_kb::record& a, const cell_kb::record& b) {
+        if (a.key_hash != b.key_hash)
+            return a.key_hash < b.key_hash;
+        return strncmp(a.key, b.key, sizeof(a.key)) < 0;
+    }
+
+    bool record_same(const cell_kb::record& a, const cell_kb::record& b) {
+        return a.key_hash == b.key_hash && strncmp(a.key, b.key, sizeof(a.key)) == 0;
+    }
+
+    // Copy into a fixed field; false if it would not fit with its terminator
+    template<size_t N>
+    bool put_str(char (&dst)[N], const std::string& src) {
+        if (src.size() >= N)
+            return false;
+        memcpy(dst, src.data(), src.size());
+        memset(dst + src.size(), 0, N - src.size());
+        return true;
+    }
+
+    template<size_t N>
+    std::string get_str(const char (&src)[N]) {
+        return std::string(src, strnlen(src, N));
+    }
+
+    bool write_all(int fd, const void *data, size_t len) {
+        auto p = static_cast<const char *>(data);
+        while (len > 0) {
+            auto r = write(fd, p, len);
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            p += r;
+            len -= r;
+        }
+        return true;
+    }
+}
+
+cell_kb::mapping::~mapping() {
+    if (base != nullptr)
+        munmap(base, length);
+}
+
+std::shared_ptr<const cell_kb::mapping> cell_kb::map_file(const std::string& path, std::string& err) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != ENOENT)
+            err = "unable to open " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(header)) {
+        err = path + " is too short to be a cell snapshot";
+        close(fd);
+        return nullptr;
+    }
+
+    void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        err = "unable to map " + path + ": " + strerror(errno);
+        return nullptr;
+    }
+
+    auto m = std::make_shared<mapping>();
+    m->base = base;
+    m->length = st.st_size;
+
+    const auto hdr = static_cast<const header *>(base);
+    if (hdr->magic != file_magic || hdr->byte_order != byte_order ||
+            hdr->version != file_version || hdr->record_size != sizeof(record) ||
+            m->length != sizeof(header) + hdr->count * sizeof(record)) {
+        err = path + " is not a compatible cell snapshot";
+        return nullptr;
+    }
+
+    m->records = reinterpret_cast<const record *>(static_cast<const char *>(base) + sizeof(header));
+    m->count = hdr->count;
+
+    // Lookups touch a handful of pages each; don't read ahead
+    madvise(base, m->length, MADV_RANDOM);
+
+    return m;
+}
+
+bool cell_kb::open(const std::string& in_path, std::string& err) {
+    auto m = map_file(in_path, err);
+
+    std::lock_guard<std::mutex> lk(mutex);
+    path = in_path;
+    map = m;
+
+    return err.empty();
+}
+
+std::shared_ptr<const cell_kb::mapping> cell_kb::current() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return map;
+}
+
+std::optional<cell_kb::record> cell_kb::lookup(const std::string& key) const {
+    auto m = current();
+    if (m == nullptr || key.size() >= sizeof(record::key))
+        return std::nullopt;
+
+    record probe;
+    probe.key_hash = hash_key(key);
+    put_str(probe.key, key);
+
+    auto end = m->records + m->count;
+    auto ri = std::lower_bound(m->records, end, probe, record_less);
+    if (ri == end || !record_same(*ri, probe))
+        return std::nullopt;
+
+    return *ri;
+}
+
+size_t cell_kb::size() const {
+    auto m = current();
+    return m == nullptr ? 0 : m->count;
+}
+
+void cell_kb::retain(const record& rec) {
+    std::lock_guard<std::mutex> lk(mutex);
+    retained[get_str(rec.key)] = rec;
+}
+
+bool cell_kb::save(std::vector<record> live, std::string& err) {
+    std::lock_guard<std::mutex> save_lk(save_mutex);
+
+    std::unordered_map<std::string, record> held;
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        if (path.empty()) {
+            err = "no snapshot path";
+            return false;
+        }
+        held = retained;
+    }
+
+    // Live state beats a retained copy of the same cell
+    std::sort(live.begin(), live.end(), record_less);
+    for (auto& r : held)
+        if (!std::binary_search(live.begin(), live.end(), r.second, record_less))
+            live.push_back(r.second);
+    std::sort(live.begin(), live.end(), record_less);
+
+    auto m = current();
+    std::string tmp_path = path + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        err = "unable to create " + tmp_path + ": " + strerror(errno);
+        return false;
+    }
+
+    header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = file_magic;
+    hdr.version = file_version;
+    hdr.record_size = sizeof(record);
+    hdr.byte_order = byte_order;
+    hdr.saved = time(nullptr);
+
+    bool ok = write_all(fd, &hdr, sizeof(hdr));
+
+    // Merge with the mapped records; both sides are sorted
+    const record *oi = m != nullptr ? m->records : nullptr;
+    const record *oend = m != nullptr ? m->records + m->count : nullptr;
+    auto li = live.begin();
+    uint64_t count = 0;
+
+    std::vector<record> buf;
+    buf.reserve(1024);
+
+    while (ok && (li != live.end() || oi != oend)) {
+        if (oi == oend || (li != live.end() && !record_less(*oi, *li))) {
+            if (oi != oend && record_same(*oi, *li))
+                ++oi;
+            buf.push_back(*li++);
+        } else {
+            buf.push_back(*oi++);
+        }
+
+        if (buf.size() == buf.capacity()) {
+            ok = write_all(fd, buf.data(), buf.size() * sizeof(record));
+            count += buf.size();
+            buf.clear();
+        }
+    }
+
+    if (ok && !buf.empty()) {
+        ok = write_all(fd, buf.data(), buf.size() * sizeof(record));
+        count += buf.size();
+    }
+
+    hdr.count = count;
+    if (ok)
+        ok = pwrite(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) && fsync(fd) == 0;
+
+    if (!ok)
+        err = "unable to write " + tmp_path + ": " + strerror(errno);
+    close(fd);
+
+    if (ok && rename(tmp_path.c_str(), path.c_str()) < 0) {
+        err = "unable to replace " + path + ": " + strerror(errno);
+        ok = false;
+    }
+
+    if (!ok) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    auto nm = map_file(path, err);
+
+    std::lock_guard<std::mutex> lk(mutex);
+    if (nm != nullptr)
+        map = nm;
+
+    // Anything retained since we copied the set waits for the next save
+    for (const auto& r : held) {
+        auto ri = retained.find(r.first);
+        if (ri != retained.end() && record_same(ri->second, r.second) &&
+                ri->second.last_seen == r.second.last_seen)
+            retained.erase(ri);
+    }
+
+    return nm != nullptr;
+}
+
+uint64_t cell_kb::hash_key(const std::string& key) {
+    // FNV-1a; stable across builds, unlike std::hash
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+std::optional<cell_kb::record> cell_kb::make_record(const cell_summary_row& row,
+        const std::optional<cell_tower_estimate>& est) {
+    record rec;
+    memset(&rec, 0, sizeof(rec));
+
+    if (!put_str(rec.key, row.key))
+        return std::nullopt;
+
+    // Overlong identity fields are dropped rather than the whole cell
+    put_str(rec.rat, row.rat);
+    put_str(rec.mcc, row.mcc);
+    put_str(rec.mnc, row.mnc);
+    put_str(rec.tac, row.tac);
+    put_str(rec.cid, row.cid);
+    put_str(rec.pci, row.pci);
+    put_str(rec.arfcn, row.arfcn);
+    put_str(rec.band, row.band);
+
+    rec.key_hash = hash_key(row.key);
+    rec.first_seen = row.first_seen;
+    rec.last_seen = row.last_seen;
+    rec.packets = row.packets;
+
+    if (row.has_signal) {
+        rec.flags |= rec_has_signal;
+        rec.best_signal = row.best_signal;
+    }
+
+    if (est) {
+        rec.flags |= rec_has_tower;
+        rec.tower_lat = est->lat;
+        rec.tower_lon = est->lon;
+        rec.tower_radius_m = est->radius_m;
+        rec.tower_samples = static_cast<uint32_t>(std::min<uint64_t>(est->samples, UINT32_MAX));
+    } else if (row.has_tower) {
+        rec.flags |= rec_has_tower;
+        rec.tower_lat = row.tower_lat;
+        rec.tower_lon = row.tower_lon;
+    }
+
+    return rec;
+}
+
+cell_summary_row cell_kb::to_row(const record& rec) {
+    cell_summary_row row;
+
+    row.key = get_str(rec.key);
+    row.rat = get_str(rec.rat);
+    row.mcc = get_str(rec.mcc);
+    row.mnc = get_str(rec.mnc);
+    row.tac = get_str(rec.tac);
+    row.cid = get_str(rec.cid);
+    row.pci = get_str(rec.pci);
+    row.arfcn = get_str(rec.arfcn);
+    row.band = get_str(rec.band);
+    row.first_seen = rec.first_seen;
+    row.last_seen = rec.last_seen;
+    row.packets = rec.packets;
+
+    // The last signal is from another run; only the best carries over
+    if (rec.flags & rec_has_signal) {
+        row.has_signal = true;
+        row.signal = row.best_signal = rec.best_signal;
+    }
+
+    if (rec.flags & rec_has_tower) {
+        row.has_tower = true;
+        row.tower_lat = rec.tower_lat;
+        row.tower_lon = rec.tower_lon;
+    }
+
+    return row;
+}
+
+std::optional<cell_tower_estimate> cell_kb::to_estimate(const record& rec) {
+    if (!(rec.flags & rec_has_tower) || rec.tower_samples == 0)
+        return std::nullopt;
+
+    cell_tower_estimate est;
+    est.lat = rec.tower_lat;
+    est.lon = rec.tower_lon;
+    est.radius_m = rec.tower_radius_m;
+    est.samples = rec.tower_samples;
+    return est;
+}
@@ -0,0 +1,132 @@
+/*
+ * Warm-start knowledge base of previously seen cells
+ *
+ * A snapshot of what the PHY knew about every cell (identity, band/channel,
+ * first/last seen, best signal, transmitter estimate) is written as a flat
+ * file of fixed-size records sorted by key hash, and memory-mapped read-only
+ * when the plugin starts.  Opening it costs the same for ten cells or a
+ * million; a lookup is a binary search over the mapping, and nothing is
+ * copied out until a cell is actually heard again.
+ *
+ * Saving merges the live cells, any cells moved out of memory since the last
+ * save, and every mapped record not superseded by either, so cells not heard
+ * in this run are carried forward.  The new file replaces the old one with a
+ * rename and is then mapped in its place.
+ *
+ * Records are in host byte order; a snapshot from a host of the other
+ * endianness, or of another version, is ignored rather than converted.
+ */
+
+#ifndef __CELL_KB_H__
+#define __CELL_KB_H__
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cell_summary.h"
+#include "cell_tower.h"
+
+class cell_kb {
+public:
+    static constexpr uint32_t file_magic = 0x31424b43;    // "CKB1"
+    static constexpr uint16_t file_version = 1;
+    static constexpr uint32_t byte_order = 0x01020304;
+
+    static constexpr uint16_t rec_has_signal = 1 << 0;
+    static constexpr uint16_t rec_has_tower = 1 << 1;
+
+    struct header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t record_size;
+        uint32_t byte_order;
+        uint32_t reserved;
+        uint64_t count;
+        uint64_t saved;             // unix time
+        uint8_t pad[32];
+    };
+
+    struct record {
+        uint64_t key_hash;
+        double first_seen;
+        double last_seen;
+        double tower_lat;
+        double tower_lon;
+        uint64_t packets;
+        float tower_radius_m;
+        uint32_t tower_samples;
+        int16_t best_signal;
+        uint16_t flags;
+        uint32_t reserved;
+
+        char key[64];
+        char rat[8];
+        char mcc[4];
+        char mnc[4];
+        char tac[12];
+        char cid[24];
+        char pci[8];
+        char arfcn[8];
+        char band[8];
+        char pad[4];
+    };
+
+    cell_kb() { }
+
+    cell_kb(const cell_kb&) = delete;
+    cell_kb& operator=(const cell_kb&) = delete;
+
+    // Map the snapshot at path.  A missing file is an empty knowledge base;
+    // an unreadable or incompatible one is reported in err and left to be
+    // replaced by the next save.  Either way saves go to path.
+    bool open(const std::string& path, std::string& err);
+
+    std::optional<record> lookup(const std::string& key) const;
+
+    // Mapped records
+    size_t size() const;
+
+    // Hold a record for a cell leaving the live tables until the next save
+    void retain(const record& rec);
+
+    // Write and map a new snapshot from the live cells plus everything
+    // already known
+    bool save(std::vector<record> live, std::string& err);
+
+    // Conversions to and from the PHY tables.  make_record returns nothing
+    // for a key too long for the fixed layout.
+    static uint64_t hash_key(const std::string& key);
+    static std::optional<record> make_record(const cell_summary_row& row,
+            const std::optional<cell_tower_estimate>& est);
+    static cell_summary_row to_row(const record& rec);
+    static std::optional<cell_tower_estimate> to_estimate(const record& rec);
+
+protected:
+    struct mapping {
+        ~mapping();
+
+        void *base = nullptr;
+        size_t length = 0;
+        const record *records = nullptr;
+        size_t count = 0;
+    };
+
+    std::shared_ptr<const mapping> current() const;
+    static std::shared_ptr<const mapping> map_file(const std::string& path, std::string& err);
+
+    std::string path;
+
+    mutable std::mutex mutex;
+    std::shared_ptr<const mapping> map;
+    std::unordered_map<std::string, record> retained;
+
+    // Saves from the timer and from shutdown don't overlap
+    std::mutex save_mutex;
+};
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * Pipeline metrics for the cell PHY; see cell_metrics.h
+ */
+
+#include "cell_metrics.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+    std::string escape_label(const std::string& in) {
+        std::string out;
+        out.reserve(in.size());
+        for (auto c : in) {
+            if (c == '\\' || c == '"')
+                out += '\\';
+            if (c == '\n') {
+                out += "\\n";
+                continue;
+            }
+            out += c;
+        }
+        return out;
+    }
+
+    bool valid_metric_suffix(const std::string& s) {
+        if (s.empty())
+            return false;
+        for (auto c : s)
+            if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_'))
+                return false;
+        return true;
+    }
+
+    // Helper fields that describe current state rather than running totals
+    const std::set<std::string> helper_gauges = { "queue_used", "queue_size", "compressed" };
+
+    // Exact decimal seconds; a double in the default 6 significant digits
+    // loses the microseconds once the sum passes a second
+    std::string micros_as_seconds(uint64_t us) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%" PRIu64 ".%06" PRIu64, us / 1000000, us % 1000000);
+        return buf;
+    }
+
+    std::atomic<uint64_t> next_instance{1};
+}
+
+constexpr std::array<uint64_t, 10> cell_metrics::latency_bounds_us;
+
+cell_metrics::cell_metrics() :
+    instance(next_instance.fetch_add(1, std::memory_order_relaxed)) {
+    for (auto& b : latency_buckets)
+        b.store(0, std::memory_order_relaxed);
+}
+
+cell_metrics::source_counters& cell_metrics::counters_for(const std::string& source) {
+    // Counters are never removed, so a thread can keep what it looked up
+    thread_local uint64_t cache_instance = 0;
+    thread_local std::unordered_map<std::string, source_counters *> cache;
+
+    if (cache_instance != instance) {
+        cache.clear();
+        cache_instance = instance;
+    }
+
+    auto ci = cache.find(source);
+    if (ci != cache.end())
+        return *ci->second;
+
+    std::lock_guard<std::mutex> lk(mutex);
+    auto& sc = sources[source];
+    if (sc == nullptr)
+        sc = std::make_unique<source_counters>();
+    cache.emplace(source, sc.get());
+    return *sc;
+}
+
+void cell_metrics::frame(const std::string& source) {
+    counters_for(source).frames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void cell_metrics::parse_failure(const std::string& source) {
+    counters_for(source).parse_failures.fetch_add(1, std::memory_order_relaxed);
+}
+
+void cell_metrics::processed(uint64_t elapsed_us) {
+    size_t b = 0;
+    while (b < latency_bounds_us.size() && elapsed_us > latency_bounds_us[b])
+        b++;
+    latency_buckets[b].fetch_add(1, std::memory_order_relaxed);
+    latency_sum_us.fetch_add(elapsed_us, std::memory_order_relaxed);
+    latency_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool cell_metrics::helper_stats(const std::string& source, const std::string& json) {
+    nlohmann::json j;
+    try {
+        j = nlohmann::json::parse(json);
+    } catch (...) {
+        return false;
+    }
+    if (!j.is_object())
+        return false;
+
+    std::map<std::string, double> vals;
+    for (auto it = j.begin(); it != j.end(); ++it) {
+        if (it.value().is_number() && valid_metric_suffix(it.key()))
+            vals[it.key()] = it.value().get<double>();
+    }
+
+    std::lock_guard<std::mutex> lk(mutex);
+    helpers[source] = std::move(vals);
+    return true;
+}
+
+std::string cell_metrics::prometheus() const {
+    std::ostringstream os;
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    os << "# HELP cell_frames_total JSON frames received by the cell PHY\n"
+       << "# TYPE cell_frames_total counter\n";
+    for (const auto& s : sources)
+        os << "cell_frames_total{source=\"" << escape_label(s.first) << "\"} "
+           << s.second->frames.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_parse_failures_total Frames that could not be parsed as JSON\n"
+       << "# TYPE cell_parse_failures_total counter\n";
+    for (const auto& s : sources)
+        os << "cell_parse_failures_total{source=\"" << escape_label(s.first) << "\"} "
+           << s.second->parse_failures.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_devices_created_total Cells seen for the first time this run\n"
+       << "# TYPE cell_devices_created_total counter\n"
+       << "cell_devices_created_total " << devices_created.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_tags_emitted_total Device tags attached to packets\n"
+       << "# TYPE cell_tags_emitted_total counter\n"
+       << "cell_tags_emitted_total " << tags.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_spill_evictions_total Idle cells moved to the spill store\n"
+       << "# TYPE cell_spill_evictions_total counter\n"
+       << "cell_spill_evictions_total " << spilled.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_spill_restores_total Spilled cells restored when heard again\n"
+       << "# TYPE cell_spill_restores_total counter\n"
+       << "cell_spill_restores_total " << restored.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_live_cells Cells held in memory\n"
+       << "# TYPE cell_live_cells gauge\n"
+       << "cell_live_cells " << live_cells.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_spilled_cells Cells held only in the spill store\n"
+       << "# TYPE cell_spilled_cells gauge\n"
+       << "cell_spilled_cells " << spilled_cells.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_spill_file_bytes Size of the spill store file\n"
+       << "# TYPE cell_spill_file_bytes gauge\n"
+       << "cell_spill_file_bytes " << spill_bytes.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_kb_recalls_total Cells first heard this run that the snapshot already knew\n"
+       << "# TYPE cell_kb_recalls_total counter\n"
+       << "cell_kb_recalls_total " << recalled.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_kb_cells Cells in the mapped knowledge snapshot\n"
+       << "# TYPE cell_kb_cells gauge\n"
+       << "cell_kb_cells " << kb_cells.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_coalesced_frames_total Observations folded into another source's device update\n"
+       << "# TYPE cell_coalesced_frames_total counter\n"
+       << "cell_coalesced_frames_total " << coalesced_frames.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_pci_resolved_total Partial cells given a full identity from the PCI cache\n"
+       << "# TYPE cell_pci_resolved_total counter\n"
+       << "cell_pci_resolved_total " << pci_hits.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_pci_unresolved_total Partial cells the PCI cache had no identity for\n"
+       << "# TYPE cell_pci_unresolved_total counter\n"
+       << "cell_pci_unresolved_total " << pci_misses.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_pci_cache_entries Serving cell identities in the PCI cache\n"
+       << "# TYPE cell_pci_cache_entries gauge\n"
+       << "cell_pci_cache_entries " << pci_entries.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_heatmap_bins Coverage heatmap bins held\n"
+       << "# TYPE cell_heatmap_bins gauge\n"
+       << "cell_heatmap_bins " << heatmap_bins.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_heatmap_evictions_total Cold heatmap bins dropped to stay under the bin limit\n"
+       << "# TYPE cell_heatmap_evictions_total counter\n"
+       << "cell_heatmap_evictions_total " << heatmap_evicted.load(std::memory_order_relaxed) << "\n";
+
+    os << "# HELP cell_phy_processing_seconds Time spent in the cell PHY packet handler\n"
+       << "# TYPE cell_phy_processing_seconds histogram\n";
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b < latency_bounds_us.size(); b++) {
+        cumulative += latency_buckets[b].load(std::memory_order_relaxed);
+        os << "cell_phy_processing_seconds_bucket{le=\"" << latency_bounds_us[b] / 1e6 << "\"} "
+           << cumulative << "\n";
+    }
+    cumulative += latency_buckets[latency_bounds_us.size()].load(std::memory_order_relaxed);
+    os << "cell_phy_processing_seconds_bucket{le=\"+Inf\"} " << cumulative << "\n"
+       << "cell_phy_processing_seconds_sum "
+       << micros_as_seconds(latency_sum_us.load(std::memory_order_relaxed)) << "\n"
+       << "cell_phy_processing_seconds_count "
+       << latency_count.load(std::memory_order_relaxed) << "\n";
+
+    // Helper counters, grouped by metric so each gets a single TYPE line
+    std::map<std::string, std::map<std::string, double>> by_metric;
+    for (const auto& h : helpers)
+        for (const auto& v : h.second)
+            by_metric[v.first][h.first] = v.second;
+
+    for (const auto& m : by_metric) {
+        bool gauge = helper_gauges.count(m.first) != 0;
+        auto name = "cell_helper_" + m.first + (gauge ? "" : "_total");
+        os << "# TYPE " << name << (gauge ? " gauge" : " counter") << "\n";
+        for (const auto& s : m.second)
+            os << name << "{source=\"" << escape_label(s.first) << "\"} "
+               << static_cast<uint64_t>(s.second) << "\n";
+    }
+
+    return os.str();
+}
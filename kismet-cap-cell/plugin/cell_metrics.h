@@ -0,0 +1,107 @@
+/*
+ * Pipeline metrics for the cell PHY and its capture helpers
+ *
+ * Counters are relaxed atomics so the packet handler can bump them without
+ * locking.  The per-source tables take a mutex only the first time a thread
+ * sees a source; after that each thread finds the counters in its own cache.
+ * The capture helper periodically forwards its own counters as a "cellstats"
+ * JSON frame, the latest of which is kept per source.
+ *
+ * Everything is rendered in the Prometheus text exposition format.
+ */
+
+#ifndef __CELL_METRICS_H__
+#define __CELL_METRICS_H__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class cell_metrics {
+public:
+    // PHY processing time histogram upper bounds, in microseconds
+    static constexpr std::array<uint64_t, 10> latency_bounds_us = {
+        10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000,
+    };
+
+    cell_metrics();
+
+    cell_metrics(const cell_metrics&) = delete;
+    cell_metrics& operator=(const cell_metrics&) = delete;
+
+    void frame(const std::string& source);
+    void parse_failure(const std::string& source);
+    void device_created() { devices_created.fetch_add(1, std::memory_order_relaxed); }
+    void tags_emitted(size_t n) { tags.fetch_add(n, std::memory_order_relaxed); }
+    void processed(uint64_t elapsed_us);
+
+    // Idle cell eviction: counters plus the live/spilled sizes after the
+    // latest change
+    void cell_spilled() { spilled.fetch_add(1, std::memory_order_relaxed); }
+    void cell_restored() { restored.fetch_add(1, std::memory_order_relaxed); }
+    void kb_recalled() { recalled.fetch_add(1, std::memory_order_relaxed); }
+    void kb_size(uint64_t n) { kb_cells.store(n, std::memory_order_relaxed); }
+    void coalesced() { coalesced_frames.fetch_add(1, std::memory_order_relaxed); }
+    void pci_resolved() { pci_hits.fetch_add(1, std::memory_order_relaxed); }
+    void pci_unresolved() { pci_misses.fetch_add(1, std::memory_order_relaxed); }
+    void pci_cache_size(uint64_t n) { pci_entries.store(n, std::memory_order_relaxed); }
+    void heatmap_sizes(uint64_t held, uint64_t evicted) {
+        heatmap_bins.store(held, std::memory_order_relaxed);
+        heatmap_evicted.store(evicted, std::memory_order_relaxed);
+    }
+    void spill_sizes(uint64_t live, uint64_t stored, uint64_t bytes) {
+        live_cells.store(live, std::memory_order_relaxed);
+        spilled_cells.store(stored, std::memory_order_relaxed);
+        spill_bytes.store(bytes, std::memory_order_relaxed);
+    }
+
+    // Replace the helper counters for a source with a cellstats payload;
+    // returns false if the payload is not a JSON object
+    bool helper_stats(const std::string& source, const std::string& json);
+
+    std::string prometheus() const;
+
+protected:
+    struct source_counters {
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> parse_failures{0};
+    };
+
+    source_counters& counters_for(const std::string& source);
+
+    // Tells the per-thread caches of one instance from a later one at the
+    // same address
+    const uint64_t instance;
+
+    std::atomic<uint64_t> devices_created{0};
+    std::atomic<uint64_t> tags{0};
+
+    std::atomic<uint64_t> spilled{0};
+    std::atomic<uint64_t> restored{0};
+    std::atomic<uint64_t> live_cells{0};
+    std::atomic<uint64_t> spilled_cells{0};
+    std::atomic<uint64_t> spill_bytes{0};
+    std::atomic<uint64_t> recalled{0};
+    std::atomic<uint64_t> kb_cells{0};
+    std::atomic<uint64_t> coalesced_frames{0};
+    std::atomic<uint64_t> pci_hits{0};
+    std::atomic<uint64_t> pci_misses{0};
+    std::atomic<uint64_t> pci_entries{0};
+    std::atomic<uint64_t> heatmap_bins{0};
+    std::atomic<uint64_t> heatmap_evicted{0};
+
+    std::array<std::atomic<uint64_t>, latency_bounds_us.size() + 1> latency_buckets;
+    std::atomic<uint64_t> latency_sum_us{0};
+    std::atomic<uint64_t> latency_count{0};
+
+    mutable std::mutex mutex;
+    // Node-stable, so references handed out by counters_for stay valid
+    std::map<std::string, std::unique_ptr<source_counters>> sources;
+    std::map<std::string, std::map<std::string, double>> helpers;
+};
+
+#endif
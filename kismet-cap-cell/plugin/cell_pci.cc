@@ -0,0 +1,261 @@
+/*
+ * PCI to full cell identity cache; see cell_pci.h
+ */
+
+#include "cell_pci.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    constexpr size_t min_slots = 1024;
+
+    constexpr double earth_radius_m = 6371000.0;
+
+    // Copy into a fixed field; false if it would not fit with its terminator
+    template<size_t N>
+    bool put_str(char (&dst)[N], const std::string& src) {
+        if (src.size() >= N)
+            return false;
+        memcpy(dst, src.data(), src.size());
+        memset(dst + src.size(), 0, N - src.size());
+        return true;
+    }
+
+    template<size_t N>
+    std::string get_str(const char (&src)[N]) {
+        return std::string(src, strnlen(src, N));
+    }
+
+    template<size_t N>
+    bool same_str(const char (&a)[N], const char (&b)[N]) {
+        return strncmp(a, b, N) == 0;
+    }
+
+    bool parse_digits(const std::string& s, size_t min_len, size_t max_len, unsigned int& out) {
+        if (s.size() < min_len || s.size() > max_len)
+            return false;
+        out = 0;
+        for (auto c : s) {
+            if (c < '0' || c > '9')
+                return false;
+            out = out * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    unsigned int rat_code(const std::string& rat) {
+        if (rat == "LTE")
+            return 1;
+        if (rat == "NR")
+            return 2;
+        if (rat == "WCDMA")
+            return 3;
+        if (rat == "GSM")
+            return 4;
+        return 7;
+    }
+}
+
+cell_pci_cache::cell_pci_cache(unsigned int in_expiry_secs, double in_max_distance_m) :
+    expiry_secs(in_expiry_secs),
+    max_distance_m(in_max_distance_m) { }
+
+bool cell_pci_cache::unknown_id(const std::string& v) {
+    // Empty, negative, or Android's CellInfo.UNAVAILABLE / UNAVAILABLE_LONG
+    return v.empty() || v[0] == '-' || v == "2147483647" || v == "9223372036854775807";
+}
+
+uint64_t cell_pci_cache::make_key(const std::string& mcc, const std::string& mnc,
+        const std::string& rat, int arfcn, int pci, bool with_plmn) {
+    if (arfcn < 0 || arfcn >= (1 << 22) || pci < 0 || pci >= (1 << 11))
+        return 0;
+
+    // 0 is the no-PLMN key; a 3-digit MNC differs from the 2-digit one with
+    // the same value
+    uint64_t plmn = 0;
+    if (with_plmn) {
+        unsigned int mcc_n, mnc_n;
+        if (!parse_digits(mcc, 3, 3, mcc_n) || !parse_digits(mnc, 2, 3, mnc_n))
+            return 0;
+        plmn = 1 + mcc_n * 1000 + mnc_n + (mnc.size() == 3 ? 1000000 : 0);
+    }
+
+    return (1ULL << 63) | (plmn << 36) | (uint64_t{rat_code(rat)} << 33) |
+        (static_cast<uint64_t>(arfcn) << 11) | static_cast<uint64_t>(pci);
+}
+
+size_t cell_pci_cache::slot_hash(uint64_t key) {
+    // splitmix64 finalizer; the packed fields are far from uniform
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return static_cast<size_t>(key);
+}
+
+double cell_pci_cache::distance_m(double lat1, double lon1, double lat2, double lon2) {
+    // Equirectangular; plenty at cell distances
+    double x = (lon2 - lon1) * M_PI / 180.0 * std::cos((lat1 + lat2) / 2 * M_PI / 180.0);
+    double y = (lat2 - lat1) * M_PI / 180.0;
+    return std::sqrt(x * x + y * y) * earth_radius_m;
+}
+
+bool cell_pci_cache::learn(const std::string& rat, int arfcn, int pci, const identity& id,
+        bool has_position, double lat, double lon, uint64_t now) {
+    if (unknown_id(id.cid) || unknown_id(id.tac))
+        return false;
+
+    uint64_t key = make_key(id.mcc, id.mnc, rat, arfcn, pci, true);
+    uint64_t any_plmn_key = make_key(id.mcc, id.mnc, rat, arfcn, pci, false);
+    if (key == 0 || any_plmn_key == 0)
+        return false;
+
+    slot in;
+    memset(&in, 0, sizeof(in));
+    if (!put_str(in.mcc, id.mcc) || !put_str(in.mnc, id.mnc) || !put_str(in.tac, id.tac) ||
+            !put_str(in.cid, id.cid) || !put_str(in.fullid, id.fullid))
+        return false;
+    in.confirmed = now;
+    if (has_position) {
+        in.has_position = 1;
+        in.lat_e7 = static_cast<int32_t>(std::lround(lat * 1e7));
+        in.lon_e7 = static_cast<int32_t>(std::lround(lon * 1e7));
+    }
+
+    std::lock_guard<std::mutex> lk(mutex);
+    learn_locked(key, in, now);
+    learn_locked(any_plmn_key, in, now);
+    return true;
+}
+
+void cell_pci_cache::learn_locked(uint64_t key, const slot& in, uint64_t now) {
+    if (slots.empty())
+        slots.resize(min_slots);
+
+    // Keep the load under 0.7 so probe runs stay short
+    if ((used + 1) * 10 > slots.size() * 7)
+        rebuild_locked(now);
+
+    size_t mask = slots.size() - 1;
+    size_t i = slot_hash(key) & mask;
+    slot *reuse = nullptr;
+    double reuse_dist = max_distance_m;
+
+    for (; slots[i].key != 0; i = (i + 1) & mask) {
+        auto& s = slots[i];
+        if (s.key != key)
+            continue;
+
+        if (same_str(s.cid, in.cid) && same_str(s.tac, in.tac) &&
+                same_str(s.mcc, in.mcc) && same_str(s.mnc, in.mnc)) {
+            uint64_t k = s.key;
+            s = in;
+            s.key = k;
+            return;
+        }
+
+        // Another cell on this PCI: replace it if it has expired or was
+        // heard here too, otherwise both stay
+        if (s.confirmed + expiry_secs < now) {
+            if (reuse == nullptr)
+                reuse = &s;
+        } else if (in.has_position && s.has_position) {
+            double d = distance_m(s.lat_e7 / 1e7, s.lon_e7 / 1e7, in.lat_e7 / 1e7, in.lon_e7 / 1e7);
+            if (d <= reuse_dist) {
+                reuse = &s;
+                reuse_dist = d;
+            }
+        } else if (!in.has_position && !s.has_position && reuse == nullptr) {
+            reuse = &s;
+        }
+    }
+
+    if (reuse == nullptr) {
+        reuse = &slots[i];
+        used++;
+    }
+
+    *reuse = in;
+    reuse->key = key;
+}
+
+void cell_pci_cache::rebuild_locked(uint64_t now) {
+    std::vector<slot> live;
+    live.reserve(used);
+    for (const auto& s : slots)
+        if (s.key != 0 && s.confirmed + expiry_secs >= now)
+            live.push_back(s);
+
+    size_t n = min_slots;
+    while (n < (live.size() + 1) * 2)
+        n *= 2;
+
+    std::vector<slot> fresh(n);
+    for (const auto& s : live) {
+        size_t i = slot_hash(s.key) & (n - 1);
+        while (fresh[i].key != 0)
+            i = (i + 1) & (n - 1);
+        fresh[i] = s;
+    }
+
+    slots.swap(fresh);
+    used = live.size();
+}
+
+std::optional<cell_pci_cache::identity> cell_pci_cache::lookup(const std::string& mcc,
+        const std::string& mnc, const std::string& rat, int arfcn, int pci,
+        bool has_position, double lat, double lon, uint64_t now) const {
+    bool with_plmn = !mcc.empty() && !mnc.empty();
+    uint64_t key = make_key(mcc, mnc, rat, arfcn, pci, with_plmn);
+    if (key == 0)
+        return std::nullopt;
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    if (slots.empty())
+        return std::nullopt;
+
+    size_t mask = slots.size() - 1;
+    const slot *best = nullptr;
+    double best_dist = 0;
+
+    for (size_t i = slot_hash(key) & mask; slots[i].key != 0; i = (i + 1) & mask) {
+        const auto& s = slots[i];
+        if (s.key != key || s.confirmed + expiry_secs < now)
+            continue;
+
+        // Without two positions the candidate counts as at the edge of the
+        // area; the newer of those wins
+        double d = max_distance_m;
+        if (has_position && s.has_position) {
+            d = distance_m(lat, lon, s.lat_e7 / 1e7, s.lon_e7 / 1e7);
+            if (d > max_distance_m)
+                continue;
+        }
+
+        if (best == nullptr || d < best_dist || (d == best_dist && s.confirmed > best->confirmed)) {
+            best = &s;
+            best_dist = d;
+        }
+    }
+
+    if (best == nullptr)
+        return std::nullopt;
+
+    identity id;
+    id.mcc = get_str(best->mcc);
+    id.mnc = get_str(best->mnc);
+    id.tac = get_str(best->tac);
+    id.cid = get_str(best->cid);
+    id.fullid = get_str(best->fullid);
+    return id;
+}
+
+size_t cell_pci_cache::size() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    // Each identity is filed under two keys
+    return used / 2;
+}
@@ -0,0 +1,90 @@
+/*
+ * PCI to full cell identity cache
+ *
+ * Android reports many neighbour cells with only their physical cell id and
+ * channel; CID and TAC come back as "unavailable" (INT_MAX / LONG_MAX) and
+ * often the PLMN is missing too.  Serving cells always carry the full
+ * identity, so every serving cell observation teaches the cache which cell
+ * (PLMN, RAT, ARFCN, PCI) currently stands for, and where it was heard.  A
+ * partial cell is then looked up and attributed to that cell's device.
+ *
+ * The table is a flat array of fixed-size slots with linear probing; the
+ * identity strings live inline, so a lookup touches one short run of
+ * adjacent slots and never allocates.  PCIs are reused across an area, so a
+ * key can hold several identities; each remembers the position it was
+ * confirmed at, and a lookup takes the nearest one within max_distance_m.
+ * A cell of a different identity confirmed within that distance replaces
+ * the old one.  Identities not confirmed for expiry_secs are ignored, and
+ * dropped when the table is next rebuilt.
+ *
+ * Every identity is also filed under a key with no PLMN, for partial cells
+ * that lack one.
+ */
+
+#ifndef __CELL_PCI_H__
+#define __CELL_PCI_H__
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+class cell_pci_cache {
+public:
+    struct identity {
+        std::string mcc, mnc, tac, cid, fullid;
+    };
+
+    cell_pci_cache(unsigned int expiry_secs = 86400, double max_distance_m = 5000);
+
+    cell_pci_cache(const cell_pci_cache&) = delete;
+    cell_pci_cache& operator=(const cell_pci_cache&) = delete;
+
+    // A CID or TAC Android could not fill in
+    static bool unknown_id(const std::string& v);
+
+    // Record a fully identified (serving) cell heard on arfcn/pci.  Returns
+    // false if the identity or key does not fit the fixed layout.
+    bool learn(const std::string& rat, int arfcn, int pci, const identity& id,
+            bool has_position, double lat, double lon, uint64_t now);
+
+    // Identity for a partial cell; mcc/mnc may be empty
+    std::optional<identity> lookup(const std::string& mcc, const std::string& mnc,
+            const std::string& rat, int arfcn, int pci,
+            bool has_position, double lat, double lon, uint64_t now) const;
+
+    // Identities held, including expired ones not yet dropped
+    size_t size() const;
+
+protected:
+    struct slot {
+        uint64_t key;               // 0 marks an empty slot
+        uint64_t confirmed;         // unix time
+        int32_t lat_e7;
+        int32_t lon_e7;
+        uint8_t has_position;
+        char mcc[4];
+        char mnc[4];
+        char tac[12];
+        char cid[24];
+        char fullid[64];
+    };
+
+    static uint64_t make_key(const std::string& mcc, const std::string& mnc,
+            const std::string& rat, int arfcn, int pci, bool with_plmn);
+    static size_t slot_hash(uint64_t key);
+    static double distance_m(double lat1, double lon1, double lat2, double lon2);
+
+    void learn_locked(uint64_t key, const slot& in, uint64_t now);
+    void rebuild_locked(uint64_t now);
+
+    const uint64_t expiry_secs;
+    const double max_distance_m;
+
+    mutable std::mutex mutex;
+    std::vector<slot> slots;        // size is a power of two
+    size_t used = 0;
+};
+
+#endif
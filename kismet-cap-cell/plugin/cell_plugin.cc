@@ -11,6 +11,7 @@
  * Install: make install   (or make userinstall)
  */
 
+#include <array>
 #include <string>
 #include <fstream>
 #include <set>
@@ -32,11 +33,37 @@
 #include <entrytracker.h>
 #include <trackedelement.h>
 #include <kis_httpd_registry.h>
+#include <kis_net_beast_httpd.h>
+#include <alertracker.h>
+#include <timetracker.h>
 #include <macaddr.h>
 #include <fmt.h>
 #include <nlohmann/json.hpp>
 #include <sys/time.h>
+#include <chrono>
 #include <stdexcept>
+#include <climits>
+#include <cstdlib>
+#include <mutex>
+#include <shared_mutex>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include "cell_aggregate.h"
+#include "cell_anomaly.h"
+#include "cell_coalesce.h"
+#include "cell_handover.h"
+#include "cell_heatmap.h"
+#include "cell_kb.h"
+#include "cell_metrics.h"
+#include "cell_pci.h"
+#include "cell_spill.h"
+#include "cell_summary.h"
+#include "cell_tower.h"
+
+#include "../cell_bands.h"
+#include "../cell_record.h"
 
 class kis_datasource_cell : public kis_datasource {
 public:
@@ -86,6 +113,10 @@ public:
     __Proxy(rsrp, std::string, std::string, std::string, rsrp);
     __Proxy(rsrq, std::string, std::string, std::string, rsrq);
     __Proxy(band, std::string, std::string, std::string, band);
+    __Proxy(tower_lat, double, double, double, tower_lat);
+    __Proxy(tower_lon, double, double, double, tower_lon);
+    __Proxy(tower_radius_m, double, double, double, tower_radius_m);
+    __Proxy(tower_samples, uint64_t, uint64_t, uint64_t, tower_samples);
 
 protected:
     virtual void register_fields() override {
@@ -102,13 +133,23 @@ protected:
         register_field("cell.device.rsrp", "RSRP", &rsrp);
         register_field("cell.device.rsrq", "RSRQ", &rsrq);
         register_field("cell.device.band", "Band", &band);
+        register_field("cell.device.tower_lat", "Estimated transmitter latitude", &tower_lat);
+        register_field("cell.device.tower_lon", "Estimated transmitter longitude", &tower_lon);
+        register_field("cell.device.tower_radius_m", "Transmitter estimate uncertainty (m)", &tower_radius_m);
+        register_field("cell.device.tower_samples", "Observations in transmitter estimate", &tower_samples);
     }
 private:
     std::shared_ptr<tracker_element_string> fullid, rat, mcc, mnc, tac, cid, arfcn, pci, rssi, rsrp, rsrq, band;
+    std::shared_ptr<tracker_element_double> tower_lat, tower_lon, tower_radius_m;
+    std::shared_ptr<tracker_element_uint64> tower_samples;
 };
 
 class kis_cell_phy : public kis_phy_handler {
 public:
+    // Weak instance handed to register_phy_handler, which builds the real one
+    // via create_phy_handler; it must not claim handlers or routes.
+    kis_cell_phy() : kis_phy_handler() { }
+
     kis_cell_phy(int phyid) : kis_phy_handler(phyid) {
         set_phy_name("CELL");
 
@@ -122,23 +163,428 @@ public:
         pack_comp_radiodata = packetchain->register_packet_component("RADIODATA");
         pack_comp_gps = packetchain->register_packet_component("GPS");
         pack_comp_devicetag = packetchain->register_packet_component("DEVICETAG");
+        pack_comp_datasrc = packetchain->register_packet_component("KISDATASRC");
+        pack_comp_linkframe = packetchain->register_packet_component("LINKFRAME");
 
         cell_common_id =
             Globalreg::globalreg->entrytracker->register_field("cell.device",
                 tracker_element_factory<cell_tracked_common>(),
                 "Cellular cell");
 
+        auto conf = Globalreg::globalreg->kismet_config;
+
+        // Only the kismetdb log keeps packet metablobs
+        log_record_meta = conf->fetch_opt_bool("enable_logging", true) &&
+            conf->fetch_opt_bool("kis_log_packets", true) &&
+            conf->fetch_opt("log_types").find("kismet") != std::string::npos;
+        cell_anomaly_detector::config anomaly_conf;
+        anomaly_conf.strong_sigma =
+            conf->fetch_opt_as<double>("cell_alert_strong_sigma", anomaly_conf.strong_sigma);
+        anomaly_conf.strong_floor_dbm =
+            conf->fetch_opt_as<int>("cell_alert_strong_floor_dbm", anomaly_conf.strong_floor_dbm);
+        anomaly_conf.collision_window_secs =
+            conf->fetch_opt_as<unsigned int>("cell_alert_collision_window", anomaly_conf.collision_window_secs);
+        anomaly_conf.collision_distance_m =
+            conf->fetch_opt_as<double>("cell_alert_collision_distance_m", anomaly_conf.collision_distance_m);
+        anomaly_conf.downgrade_window_secs =
+            conf->fetch_opt_as<unsigned int>("cell_alert_downgrade_window", anomaly_conf.downgrade_window_secs);
+        anomalies = std::make_unique<cell_anomaly_detector>(anomaly_conf);
+
+        handovers = std::make_unique<cell_handover_tracker>(
+                conf->fetch_opt_as<size_t>("cell_handover_ring", 256),
+                conf->fetch_opt_as<unsigned int>("cell_handover_pingpong_secs", 10));
+
+        auto coalesce_ms = conf->fetch_opt_as<unsigned int>("cell_coalesce_ms", 500);
+        if (coalesce_ms > 0)
+            coalesce = std::make_unique<cell_coalescer>(coalesce_ms);
+
+        auto heatmap_zoom = conf->fetch_opt_as<unsigned int>("cell_heatmap_zoom", 16);
+        if (heatmap_zoom > 0)
+            heatmap = std::make_unique<cell_heatmap>(heatmap_zoom,
+                    conf->fetch_opt_as<size_t>("cell_heatmap_max_bins", 200000),
+                    conf->fetch_opt_bool("cell_heatmap_cells", true));
+
+        auto pci_cache_secs = conf->fetch_opt_as<unsigned int>("cell_pci_cache_secs", 86400);
+        if (pci_cache_secs > 0)
+            pci_cache = std::make_unique<cell_pci_cache>(pci_cache_secs,
+                    conf->fetch_opt_as<double>("cell_pci_cache_distance_m", 5000));
+
+        spill_idle_secs = conf->fetch_opt_as<unsigned int>("cell_spill_idle", 3600);
+        if (spill_idle_secs > 0) {
+            // Spilling only strips the cell record; the base device, with its
+            // location, seenby and packet maps, goes when Kismet expires it.
+            // The cell has to be spilled first or its tags go with the device.
+            auto device_timeout = conf->fetch_opt_as<unsigned int>("tracker_device_timeout", 0);
+            if (device_timeout == 0) {
+                _MSG("cell: idle cells will stay in memory; cell_spill_idle needs "
+                        "tracker_device_timeout set so Kismet drops the devices of "
+                        "spilled cells", MSGFLAG_INFO);
+                spill_idle_secs = 0;
+            } else if (device_timeout <= spill_sweep_secs) {
+                _MSG(fmt::format("cell: idle cells will stay in memory; tracker_device_timeout "
+                            "must be over {}s to spill cells before Kismet drops their "
+                            "devices", spill_sweep_secs), MSGFLAG_ERROR);
+                spill_idle_secs = 0;
+            } else if (spill_idle_secs + spill_sweep_secs > device_timeout) {
+                spill_idle_secs = device_timeout - spill_sweep_secs;
+                _MSG(fmt::format("cell: spilling cells after {}s idle to stay inside "
+                            "tracker_device_timeout", spill_idle_secs), MSGFLAG_INFO);
+            }
+        }
+        if (spill_idle_secs > 0) {
+            auto spill_path = conf->fetch_opt_dfl("cell_spill_file", "/var/lib/kismet/cell/spill.jsonl");
+            std::string err;
+            spill = std::make_unique<cell_spill_store>();
+            if (spill->open(spill_path, err)) {
+                _MSG(fmt::format("cell: moving cells idle for {}s to {} ({} already there)",
+                            spill_idle_secs, spill_path, spill->size()), MSGFLAG_INFO);
+                // Off the packet path; the sweep writes and compacts the store
+                timetracker = Globalreg::fetch_mandatory_global_as<time_tracker>();
+                spill_timer = timetracker->register_timer(std::chrono::seconds(spill_sweep_secs), 1,
+                        [this](int) -> int {
+                            spill_idle_cells();
+                            return 1;
+                        });
+            } else {
+                _MSG("cell: idle cells will stay in memory; " + err, MSGFLAG_ERROR);
+                spill.reset();
+            }
+        }
+
+        auto kb_path = conf->fetch_opt_dfl("cell_kb_file", "/var/lib/kismet/cell/knowledge.kb");
+        if (!kb_path.empty()) {
+            std::string err;
+            kb = std::make_unique<cell_kb>();
+            if (kb->open(kb_path, err))
+                _MSG(fmt::format("cell: {} known cells mapped from {}", kb->size(), kb_path), MSGFLAG_INFO);
+            else
+                _MSG("cell: starting without known cells; " + err, MSGFLAG_ERROR);
+            metrics.kb_size(kb->size());
+
+            auto interval = conf->fetch_opt_as<unsigned int>("cell_kb_save_interval", 300);
+            if (interval > 0) {
+                timetracker = Globalreg::fetch_mandatory_global_as<time_tracker>();
+                kb_timer = timetracker->register_timer(std::chrono::seconds(interval), 1,
+                        [this](int) -> int {
+                            save_kb();
+                            return 1;
+                        });
+            }
+        }
+
+        alertracker = Globalreg::fetch_mandatory_global_as<alert_tracker>();
+        alert_refs[cell_anomaly_detector::strong_new_cell] =
+            alertracker->activate_configured_alert("CELLNEWSTRONG", "CELL", kis_alert_severity::medium,
+                    "A cell seen for the first time is much stronger than new cells "
+                    "usually are, which can indicate a nearby fake base station.", phyid);
+        alert_refs[cell_anomaly_detector::tac_change] =
+            alertracker->activate_configured_alert("CELLTACCHANGE", "CELL", kis_alert_severity::medium,
+                    "A known cell ID was seen advertising a different TAC/LAC, which can "
+                    "indicate a cloned cell forcing location updates.", phyid);
+        alert_refs[cell_anomaly_detector::pci_collision] =
+            alertracker->activate_configured_alert("CELLPCICOLLISION", "CELL", kis_alert_severity::low,
+                    "Two different cell IDs were heard on the same PCI and channel within "
+                    "a short time and distance, which a planned network avoids.", phyid);
+        alert_refs[cell_anomaly_detector::rat_downgrade] =
+            alertracker->activate_configured_alert("CELLRATDOWNGRADE", "CELL", kis_alert_severity::high,
+                    "A phone's serving cell dropped from LTE/NR to GSM/WCDMA, as happens "
+                    "in downgrade attacks.", phyid);
+
         packetchain->register_handler(&PacketHandler, this, CHAINPOS_CLASSIFIER, -100);
+
+        httpd = Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>();
+
+        httpd->register_route("/phy/cell/towers", {"GET"}, httpd->RO_ROLE, {"json"},
+                std::make_shared<kis_net_web_function_endpoint>(
+                    [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                        towers_endp_handler(con);
+                    }));
+
+        httpd->register_route("/phy/cell/summary", {"GET"}, httpd->RO_ROLE, {"json"},
+                std::make_shared<kis_net_web_function_endpoint>(
+                    [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                        summary_endp_handler(con);
+                    }));
+
+        httpd->register_route("/phy/cell/aggregates", {"GET"}, httpd->RO_ROLE, {"json"},
+                std::make_shared<kis_net_web_function_endpoint>(
+                    [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                        aggregates_endp_handler(con);
+                    }));
+
+        httpd->register_route("/phy/cell/heatmap", {"GET"}, httpd->RO_ROLE, {"json"},
+                std::make_shared<kis_net_web_function_endpoint>(
+                    [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                        heatmap_endp_handler(con);
+                    }));
+
+        httpd->register_route("/phy/cell/handovers", {"GET"}, httpd->RO_ROLE, {"json"},
+                std::make_shared<kis_net_web_function_endpoint>(
+                    [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                        handovers_endp_handler(con);
+                    }));
+
+        // Prometheus scrape target; plain text, so no extension variants
+        httpd->register_route("/phy/cell/metrics", {"GET"}, httpd->RO_ROLE, {},
+                std::make_shared<kis_net_web_function_endpoint>(
+                    [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                        con->append_header("Content-Type", "text/plain; version=0.0.4");
+                        con->response_stream() << metrics.prometheus();
+                    }));
     }
 
     virtual ~kis_cell_phy() {
-        packetchain->remove_handler(&PacketHandler, CHAINPOS_CLASSIFIER);
+        if (packetchain != nullptr)
+            packetchain->remove_handler(&PacketHandler, CHAINPOS_CLASSIFIER);
+        if (httpd != nullptr) {
+            httpd->remove_route("/phy/cell/towers");
+            httpd->remove_route("/phy/cell/summary");
+            httpd->remove_route("/phy/cell/aggregates");
+            httpd->remove_route("/phy/cell/metrics");
+            httpd->remove_route("/phy/cell/handovers");
+            httpd->remove_route("/phy/cell/heatmap");
+        }
+        if (timetracker != nullptr && kb_timer >= 0)
+            timetracker->remove_timer(kb_timer);
+        if (timetracker != nullptr && spill_timer >= 0)
+            timetracker->remove_timer(spill_timer);
+        if (kb != nullptr)
+            save_kb();
     }
 
     kis_phy_handler *create_phy_handler(int phyid) override {
         return new kis_cell_phy(phyid);
     }
 
+    // Compact per-cell summary rows; since=<ts from the previous reply>
+    // returns only rows changed after it, limit caps the reply size.
+    void summary_endp_handler(std::shared_ptr<kis_net_beast_httpd_connection> con) {
+        const auto& vars = con->http_variables();
+        double since = 0;
+        size_t limit = 0;
+
+        try {
+            auto si = vars.find("since");
+            if (si != vars.end())
+                since = std::stod(si->second);
+            auto li = vars.find("limit");
+            if (li != vars.end())
+                limit = std::stoul(li->second);
+        } catch (...) {
+            con->set_status(400);
+            con->response_stream() << "Invalid since/limit\n";
+            return;
+        }
+
+        con->response_stream() << summary.dump_since(since, limit);
+    }
+
+    // PLMN/band/RAT counters; window=<minutes> (max 60), optional exact
+    // mcc, mnc, rat and band filters
+    void aggregates_endp_handler(std::shared_ptr<kis_net_beast_httpd_connection> con) {
+        const auto& vars = con->http_variables();
+        auto var = [&vars](const std::string& k) -> std::string {
+            auto vi = vars.find(k);
+            return vi == vars.end() ? "" : vi->second;
+        };
+
+        unsigned int window_min = 60;
+        int band = 0;
+        try {
+            if (!var("window").empty())
+                window_min = std::stoul(var("window"));
+            if (!var("band").empty())
+                band = std::stoi(var("band"));
+        } catch (...) {
+            con->set_status(400);
+            con->response_stream() << "Invalid window/band\n";
+            return;
+        }
+
+        con->response_stream() << aggregates.dump(time(0), window_min * 60,
+                var("mcc"), var("mnc"), var("rat"), band);
+    }
+
+    // Coverage bins; optional exact mcc, mnc, rat, band filters, cell=<composite>
+    // for one cell's layer, cells=1 to add every per-cell layer,
+    // bbox=<minlat,minlon,maxlat,maxlon> as for towers, since=<unix time>, min_count=N
+    void heatmap_endp_handler(std::shared_ptr<kis_net_beast_httpd_connection> con) {
+        if (heatmap == nullptr) {
+            con->set_status(404);
+            con->response_stream() << "Heatmap disabled (cell_heatmap_zoom=0)\n";
+            return;
+        }
+
+        const auto& vars = con->http_variables();
+        auto var = [&vars](const std::string& k) -> std::string {
+            auto vi = vars.find(k);
+            return vi == vars.end() ? "" : vi->second;
+        };
+
+        cell_heatmap::filter flt;
+        flt.mcc = var("mcc");
+        flt.mnc = var("mnc");
+        flt.rat = var("rat");
+        flt.cell = var("cell");
+        flt.cells = var("cells") == "1" || var("cells") == "true";
+        try {
+            if (!var("band").empty())
+                flt.band = std::stoi(var("band"));
+            if (!var("since").empty())
+                flt.since = std::stoull(var("since"));
+            if (!var("min_count").empty())
+                flt.min_count = std::stoul(var("min_count"));
+            if (!var("bbox").empty()) {
+                double v[4];
+                if (!parse_bbox(var("bbox"), v))
+                    throw std::invalid_argument("bbox");
+                flt.has_bbox = true;
+                flt.south = v[0];
+                flt.west = v[1];
+                flt.north = v[2];
+                flt.east = v[3];
+            }
+        } catch (...) {
+            con->set_status(400);
+            con->response_stream() << "Invalid band/since/min_count/bbox\n";
+            return;
+        }
+
+        con->response_stream() << heatmap->dump(flt, time(0));
+    }
+
+    // Serving cell handover statistics and recent events per source;
+    // optional source=<name>, limit=<events per source> (default 50),
+    // window=<minutes> for the rate (default 60)
+    void handovers_endp_handler(std::shared_ptr<kis_net_beast_httpd_connection> con) {
+        const auto& vars = con->http_variables();
+        std::string source;
+        size_t limit = 50;
+        unsigned int window_min = 60;
+
+        try {
+            auto si = vars.find("source");
+            if (si != vars.end())
+                source = si->second;
+            auto li = vars.find("limit");
+            if (li != vars.end())
+                limit = std::stoul(li->second);
+            auto wi = vars.find("window");
+            if (wi != vars.end())
+                window_min = std::stoul(wi->second);
+        } catch (...) {
+            con->set_status(400);
+            con->response_stream() << "Invalid limit/window\n";
+            return;
+        }
+
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        con->response_stream() << handovers->dump(source, limit,
+                now.tv_sec * 1000ULL + now.tv_usec / 1000, window_min * 60);
+    }
+
+    // bbox=minlat,minlon,maxlat,maxlon for the towers and heatmap endpoints:
+    // four comma separated numbers and nothing else, each a valid latitude
+    // or longitude
+    static bool parse_bbox(const std::string& bbox, double (&v)[4]) {
+        size_t pos = 0;
+        try {
+            for (int i = 0; i < 4; i++) {
+                size_t used = 0;
+                v[i] = std::stod(bbox.substr(pos), &used);
+                pos += used;
+                if (i < 3) {
+                    if (pos >= bbox.size() || bbox[pos] != ',')
+                        return false;
+                    pos++;
+                }
+            }
+        } catch (...) {
+            return false;
+        }
+
+        return pos == bbox.size() &&
+            cell_tower_index::valid_position(v[0], v[1]) &&
+            cell_tower_index::valid_position(v[2], v[3]);
+    }
+
+    // Tower estimates near a point (lat, lon, radius in m) or inside a bbox
+    // (bbox=minlat,minlon,maxlat,maxlon); limit caps the result count.
+    void towers_endp_handler(std::shared_ptr<kis_net_beast_httpd_connection> con) {
+        const auto& vars = con->http_variables();
+        auto var_double = [&vars](const std::string& k, double& out) -> bool {
+            auto vi = vars.find(k);
+            if (vi == vars.end())
+                return false;
+            try {
+                out = std::stod(vi->second);
+                return true;
+            } catch (...) {
+                return false;
+            }
+        };
+
+        double limit_d = 500;
+        var_double("limit", limit_d);
+        // Also keeps the cast defined for NaN and huge values
+        auto limit = static_cast<size_t>(std::clamp(std::isnan(limit_d) ? 0.0 : limit_d, 0.0, 1e9));
+
+        cell_tower_index::result_vec found;
+        double lat, lon, radius = 5000;
+        auto bi = vars.find("bbox");
+        if (bi != vars.end()) {
+            double b[4];
+            if (!parse_bbox(bi->second, b)) {
+                con->set_status(400);
+                con->response_stream() << "Invalid bbox, expected minlat,minlon,maxlat,maxlon\n";
+                return;
+            }
+            found = towers.in_bbox(b[0], b[1], b[2], b[3], limit);
+        } else if (var_double("lat", lat) && var_double("lon", lon)) {
+            var_double("radius", radius);
+            if (!cell_tower_index::valid_position(lat, lon) || !std::isfinite(radius) || radius < 0) {
+                con->set_status(400);
+                con->response_stream() << "Invalid lat/lon/radius\n";
+                return;
+            }
+            found = towers.near(lat, lon, radius, limit);
+        } else {
+            con->set_status(400);
+            con->response_stream() << "Expected lat/lon[/radius] or bbox\n";
+            return;
+        }
+
+        nlohmann::json out = nlohmann::json::array();
+        for (const auto& t : found) {
+            out.push_back({
+                    {"key", t.first},
+                    {"lat", t.second.lat},
+                    {"lon", t.second.lon},
+                    {"radius_m", t.second.radius_m},
+                    {"samples", t.second.samples},
+                    {"ta_samples", t.second.ta_samples},
+                    {"method", t.second.from_ta ? "ta" : "centroid"},
+                    });
+        }
+
+        con->response_stream() << out.dump();
+    }
+
+    // One cell observation, whether parsed here from JSON or normalized by
+    // the capture helper; everything downstream of parsing works on this
+    struct cell_fields {
+        std::string fullid, composite_id, channel;
+        std::string rat, mcc, mnc, tac, cid, pci, band;
+        std::optional<int> earfcn, band_num, timing_advance;
+        int rssi = 0, rsrp = 0, rsrq = 0;
+        bool registered = false;
+        std::optional<double> dl_freq, ul_freq;
+        // Phone position; only set for a real (non 0,0), in-range fix
+        bool has_location = false;
+        double lat = 0, lon = 0, alt = 0, speed = 0, heading = 0;
+    };
+
     static int PacketHandler(CHAINCALL_PARMS) {
         kis_cell_phy *cell = (kis_cell_phy *) auxdata;
 
@@ -146,15 +592,213 @@ public:
             return 0;
 
         auto json = in_pack->fetch<kis_json_packinfo>(cell->pack_comp_json);
-        if (json == nullptr)
+        std::shared_ptr<kis_datachunk> record;
+        if (json == nullptr) {
+            record = in_pack->fetch<kis_datachunk>(cell->pack_comp_linkframe);
+            if (record == nullptr || record->dlt != CELL_RECORD_DLT)
+                return 0;
+        } else if (json->type != "cell" && json->type != "cellstats") {
             return 0;
-        if (json->type != "cell")
+        }
+
+        std::string source_name;
+        auto datasrc = in_pack->fetch<packetchain_comp_datasource>(cell->pack_comp_datasrc);
+        if (datasrc != nullptr && datasrc->ref_source != nullptr)
+            source_name = datasrc->ref_source->get_source_name();
+
+        // Helper pipeline counters; not a cell observation
+        if (json != nullptr && json->type == "cellstats") {
+            cell->metrics.helper_stats(source_name, json->json_string);
             return 0;
+        }
+
+        // Account handler time on every exit path
+        struct processing_timer {
+            cell_metrics& m;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            ~processing_timer() {
+                m.processed(std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start).count());
+            }
+        } timer{cell->metrics};
+
+        cell->metrics.frame(source_name);
+
+        if (record != nullptr) {
+            auto data = record->data();
+            if (!cell_record_check(reinterpret_cast<const uint8_t *>(data.data()), data.length())) {
+                cell->metrics.parse_failure(source_name);
+                return 0;
+            }
+
+            cell_record_t rec;
+            memcpy(&rec, data.data(), sizeof(rec));
+            auto f = fields_from_record(rec);
+
+            // The phone line never reaches Kismet in this mode; log what the
+            // record carries in the same shape, if anything logs it
+            if (cell->log_record_meta &&
+                    in_pack->fetch<packet_metablob>(cell->pack_comp_meta) == nullptr)
+                in_pack->insert(cell->pack_comp_meta,
+                        std::make_shared<packet_metablob>("cell", record_json(f).dump()));
+
+            auto tags = cell->apply_cell(in_pack, f, source_name);
+            if (tags == nullptr)
+                return 0;
+
+            add_record_tags(tags->tagmap, f);
+            cell->metrics.tags_emitted(tags->tagmap.size());
+            return 1;
+        }
+
+        return cell->handle_json(in_pack, json, source_name);
+    }
+
+    // Decode a helper record; fields are little-endian on the wire
+    static cell_fields fields_from_record(const cell_record_t& rec) {
+        auto str = [](const char *s, size_t max) { return std::string(s, strnlen(s, max)); };
+        auto i32 = [](int32_t v) { return static_cast<int32_t>(le32toh(static_cast<uint32_t>(v))); };
+        auto i16 = [](int16_t v) { return static_cast<int16_t>(le16toh(static_cast<uint16_t>(v))); };
+
+        cell_fields f;
+        auto flags = le32toh(rec.flags);
+
+        f.fullid = str(rec.fullid, sizeof(rec.fullid));
+        f.composite_id = str(rec.composite, sizeof(rec.composite));
+        f.rat = str(rec.rat, sizeof(rec.rat));
+        f.mcc = str(rec.mcc, sizeof(rec.mcc));
+        f.mnc = str(rec.mnc, sizeof(rec.mnc));
+        f.tac = str(rec.tac, sizeof(rec.tac));
+        f.cid = str(rec.cid, sizeof(rec.cid));
+        f.registered = flags & CELL_REC_REGISTERED;
+
+        if (flags & CELL_REC_HAS_ARFCN) {
+            f.earfcn = i32(rec.arfcn);
+            f.channel = fmt::format("{}", *f.earfcn);
+        }
+        if (flags & CELL_REC_HAS_PCI)
+            f.pci = fmt::format("{}", i32(rec.pci));
+        if (flags & CELL_REC_HAS_BAND) {
+            f.band_num = i32(rec.band);
+            f.band = fmt::format("{}", *f.band_num);
+        }
+        if (flags & CELL_REC_HAS_TA)
+            f.timing_advance = i32(rec.timing_advance);
+        if (flags & CELL_REC_HAS_DL_FREQ)
+            f.dl_freq = le32toh(rec.dl_freq_khz) / 1000.0;
+        if (flags & CELL_REC_HAS_UL_FREQ)
+            f.ul_freq = le32toh(rec.ul_freq_khz) / 1000.0;
+
+        f.rssi = i16(rec.rssi);
+        f.rsrp = i16(rec.rsrp);
+        f.rsrq = i16(rec.rsrq);
+
+        if (flags & CELL_REC_HAS_LOCATION) {
+            f.lat = i32(rec.lat_e7) / 1e7;
+            f.lon = i32(rec.lon_e7) / 1e7;
+            f.has_location = cell_tower_index::valid_position(f.lat, f.lon);
+            f.alt = i32(rec.alt_cm) / 100.0;
+            f.speed = le32toh(rec.speed_cmps) / 100.0;
+            f.heading = le32toh(rec.heading_cdeg) / 100.0;
+        }
+
+        return f;
+    }
+
+    // Phone JSON key of the channel number for a RAT
+    static const char *arfcn_key(const std::string& rat) {
+        return rat == "NR" ? "nrarfcn" : (rat == "LTE" ? "earfcn" : "arfcn");
+    }
+
+    // The JSON path's cell.* passthrough for a record, limited to the fields
+    // it has room for; same keys as record_json, computed tags win
+    static void add_record_tags(decltype(kis_devicetag_packetinfo::tagmap)& tagmap,
+            const cell_fields& f) {
+        auto put = [&tagmap](const std::string& key, std::string value) {
+            tagmap.emplace("cell." + key, std::move(value));
+        };
+
+        put("rat", f.rat);
+        put("registered", f.registered ? "true" : "false");
+        put("mcc", f.mcc);
+        put("mnc", f.mnc);
+        put("tac", f.tac);
+        put("cid", f.cid);
+        if (f.fullid != f.composite_id)
+            put("full_cell_key", f.fullid);
+        if (!f.pci.empty())
+            put("pci", f.pci);
+        if (f.earfcn)
+            put(arfcn_key(f.rat), fmt::format("{}", *f.earfcn));
+        if (f.band_num)
+            put("band", f.band);
+        if (f.timing_advance)
+            put("timing_advance", fmt::format("{}", *f.timing_advance));
+        if (f.rssi != 0)
+            put("rssi", fmt::format("{}", f.rssi));
+        if (f.rsrp != 0)
+            put("rsrp", fmt::format("{}", f.rsrp));
+        if (f.rsrq != 0)
+            put("rsrq", fmt::format("{}", f.rsrq));
+
+        if (f.has_location) {
+            put("lat", fmt::format("{}", f.lat));
+            put("lon", fmt::format("{}", f.lon));
+            put("alt_m", fmt::format("{}", f.alt));
+            if (f.speed > 0)
+                put("speed_mps", fmt::format("{}", f.speed));
+            if (f.heading > 0)
+                put("bearing_deg", fmt::format("{}", f.heading));
+        }
+    }
+
+    // A decoded record as a phone line (SCHEMA.md keys), for the metablob
+    static nlohmann::json record_json(const cell_fields& f) {
+        nlohmann::json c = {
+            {"rat", f.rat},
+            {"registered", f.registered},
+            {"mcc", f.mcc},
+            {"mnc", f.mnc},
+            {"tac", f.tac},
+            {"cid", f.cid},
+        };
+        if (f.fullid != f.composite_id)
+            c["full_cell_key"] = f.fullid;
+        if (!f.pci.empty())
+            c["pci"] = std::atoi(f.pci.c_str());
+        if (f.earfcn)
+            c[arfcn_key(f.rat)] = *f.earfcn;
+        if (f.band_num)
+            c["band"] = *f.band_num;
+        if (f.timing_advance)
+            c["timing_advance"] = *f.timing_advance;
+        if (f.rssi != 0)
+            c["rssi"] = f.rssi;
+        if (f.rsrp != 0)
+            c["rsrp"] = f.rsrp;
+        if (f.rsrq != 0)
+            c["rsrq"] = f.rsrq;
 
+        nlohmann::json j = { {"cells", nlohmann::json::array({ std::move(c) })} };
+        if (f.has_location) {
+            j["lat"] = f.lat;
+            j["lon"] = f.lon;
+            j["alt_m"] = f.alt;
+            if (f.speed > 0)
+                j["speed_mps"] = f.speed;
+            if (f.heading > 0)
+                j["bearing_deg"] = f.heading;
+        }
+        return j;
+    }
+
+    int handle_json(const std::shared_ptr<kis_packet>& in_pack,
+            const std::shared_ptr<kis_json_packinfo>& json, const std::string& source_name) {
         nlohmann::json j;
         try {
             j = nlohmann::json::parse(json->json_string);
         } catch (...) {
+            metrics.parse_failure(source_name);
             return 0;
         }
 
@@ -187,236 +831,843 @@ public:
             } catch (...) { }
             return std::nullopt;
         };
-        struct band_info {
-            double fdl_low;
-            std::optional<double> ful_low;
-            int n_offs;
-        };
-        static const std::map<int, band_info> lte_bands = {
-            {1, {2110.0, 1920.0, 0}}, {2, {1930.0, 1850.0, 600}}, {3, {1805.0, 1710.0, 1200}},
-            {4, {2110.0, 1710.0, 1950}}, {5, {869.0, 824.0, 2400}}, {6, {830.0, 875.0, 2650}},
-            {7, {2620.0, 2500.0, 2750}}, {8, {925.0, 880.0, 3450}}, {9, {1844.9, 1749.9, 3800}},
-            {10, {2110.0, 1710.0, 4150}}, {11, {1475.9, 1427.9, 4750}}, {12, {729.0, 699.0, 5010}},
-            {13, {746.0, 777.0, 5180}}, {14, {758.0, 788.0, 5280}}, {17, {734.0, 704.0, 5035}},
-            {18, {860.0, 815.0, 5850}}, {19, {875.0, 830.0, 6000}}, {20, {791.0, 832.0, 6150}},
-            {21, {1495.9, 1447.9, 6450}}, {22, {3510.0, 3410.0, 6600}}, {23, {2180.0, 2000.0, 7500}},
-            {24, {1525.0, 1626.5, 7700}}, {25, {1930.0, 1850.0, 8040}}, {26, {859.0, 814.0, 8690}},
-            {27, {852.0, 807.0, 9040}}, {28, {758.0, 703.0, 9210}}, {29, {717.0, std::nullopt, 9660}},
-            {30, {2350.0, 2305.0, 9770}}, {31, {462.5, 452.5, 9870}}, {32, {1452.0, std::nullopt, 9920}},
-            {33, {1900.0, std::nullopt, 36000}}, {34, {2010.0, std::nullopt, 36200}},
-            {35, {1850.0, std::nullopt, 36350}}, {36, {1930.0, std::nullopt, 36950}},
-            {37, {1910.0, std::nullopt, 37550}}, {38, {2570.0, std::nullopt, 37750}},
-            {39, {1880.0, std::nullopt, 38250}}, {40, {2300.0, std::nullopt, 38650}},
-            {41, {2496.0, std::nullopt, 39650}}, {42, {3400.0, std::nullopt, 41590}},
-            {43, {3600.0, std::nullopt, 43590}}, {48, {3550.0, std::nullopt, 55240}},
-            {65, {2110.0, 1920.0, 65536}}, {66, {2110.0, 1710.0, 66436}},
-            {67, {738.0, std::nullopt, 67336}}, {68, {753.0, 698.0, 68336}}, {71, {617.0, 663.0, 13470}},
-        };
-        static const std::vector<std::tuple<int, int, int>> lte_ranges = {
-            {1, 0, 599}, {2, 600, 1199}, {3, 1200, 1949}, {4, 1950, 2399}, {5, 2400, 2649}, {6, 2650, 2749},
-            {7, 2750, 3449}, {8, 3450, 3799}, {9, 3800, 4149}, {10, 4150, 4749}, {11, 4750, 4949},
-            {12, 5010, 5179}, {13, 5180, 5279}, {14, 5280, 5379}, {17, 5730, 5849}, {18, 5850, 5999},
-            {19, 6000, 6149}, {20, 6150, 6449}, {21, 6450, 6599}, {22, 6600, 7399}, {23, 7500, 7699},
-            {24, 7700, 8039}, {25, 8040, 8689}, {26, 8690, 9039}, {27, 9040, 9209}, {28, 9210, 9659},
-            {29, 9660, 9769}, {30, 9770, 9869}, {31, 9870, 9919}, {32, 9920, 10359}, {33, 36000, 36199},
-            {34, 36200, 36349}, {35, 36350, 36949}, {36, 36950, 37549}, {37, 37550, 37749}, {38, 37750, 38249},
-            {39, 38250, 38649}, {40, 38650, 39649}, {41, 39650, 41589}, {42, 41590, 43589}, {43, 43590, 45589},
-            {48, 55240, 56739}, {65, 65536, 66435}, {66, 66436, 67335}, {67, 67336, 67535}, {68, 68336, 68585},
-            {71, 13470, 13719},
+
+        // Same rule as the helper's record (cn_signal): any number, truncated;
+        // out of int16 range, such as Android's UNAVAILABLE, is not reported
+        auto to_signal = [](const nlohmann::json& obj, const std::string& key) -> int {
+            if (!obj.contains(key) || !obj[key].is_number())
+                return 0;
+            double d = obj[key].get<double>();
+            if (!(d > -32768 && d < 32768))
+                return 0;
+            return static_cast<int>(d);
         };
-        auto derive_band = [](int earfcn) -> std::optional<int> {
-            for (const auto& t : lte_ranges) {
-                int b, lo, hi;
-                std::tie(b, lo, hi) = t;
-                if (earfcn >= lo && earfcn <= hi)
-                    return b;
+
+        // Identity, channel and signal of one cell object
+        auto read_cell = [&](const nlohmann::json& cellj) -> cell_fields {
+            cell_fields f;
+
+            // Extract identity
+            f.fullid = to_string(cellj, "full_cell_key");
+            if (f.fullid.empty())
+                f.fullid = to_string(cellj, "full_cell_id");
+
+            // Always build our composite ID <mcc><mnc>-<tac/lac>-<cid/full_cell_id>
+            f.mcc = to_string(cellj, "mcc");
+            f.mnc = to_string(cellj, "mnc");
+            f.tac = cellj.contains("tac") ? to_string(cellj, "tac") : to_string(cellj, "lac");
+            f.cid = cellj.contains("full_cell_id") ? to_string(cellj, "full_cell_id") : to_string(cellj, "cid");
+            std::stringstream composite_ss;
+            composite_ss << f.mcc << f.mnc << "-" << f.tac << "-" << f.cid;
+            f.composite_id = composite_ss.str();
+
+            if (f.fullid.empty()) {
+                f.fullid = f.composite_id;
             }
-            return std::nullopt;
+
+            f.rat = to_string(cellj, "rat");
+            f.pci = to_string(cellj, "pci");
+            f.registered = cellj.value("registered", false);
+            f.timing_advance = to_int(cellj, "timing_advance");
+
+            nlohmann::json arfcn = cellj.contains("nrarfcn") ? cellj["nrarfcn"] :
+                                   (cellj.contains("earfcn") ? cellj["earfcn"] :
+                                   (cellj.contains("arfcn") ? cellj["arfcn"] : nlohmann::json()));
+            if (arfcn.is_number()) f.channel = fmt::format("{}", arfcn.get<int>());
+            else if (arfcn.is_string()) f.channel = arfcn.get<std::string>();
+            f.earfcn = to_int(cellj, "nrarfcn");
+            if (!f.earfcn) f.earfcn = to_int(cellj, "earfcn");
+            if (!f.earfcn) f.earfcn = to_int(cellj, "arfcn");
+            f.band_num = to_int(cellj, "band");
+            if (!f.band_num && f.earfcn) {
+                int b = cell_lte_band_for_earfcn(*f.earfcn);
+                if (b != 0)
+                    f.band_num = b;
+            }
+            f.band = f.band_num ? fmt::format("{}", *f.band_num) : to_string(cellj, "band");
+
+            // Compute DL/UL if missing
+            uint32_t dl_khz, ul_khz;
+            if (f.earfcn && f.band_num && cell_lte_freqs_khz(*f.band_num, *f.earfcn, &dl_khz, &ul_khz)) {
+                f.dl_freq = dl_khz / 1000.0;
+                if (ul_khz != 0)
+                    f.ul_freq = ul_khz / 1000.0;
+            }
+
+            f.rssi = to_signal(cellj, "rssi");
+            f.rsrp = to_signal(cellj, "rsrp");
+            if (f.rssi == 0 && f.rsrp != 0)
+                f.rssi = f.rsrp; // fall back so UI signal uses something meaningful
+            f.rsrq = to_signal(cellj, "rsrq");
+
+            return f;
         };
 
         // Pick the primary cell: first registered=true, else first entry
         nlohmann::json cellj;
-        if (j.contains("cells") && j["cells"].is_array() && !j["cells"].empty()) {
-            cellj = j["cells"].front();
-            for (const auto& c : j["cells"]) {
-                if (c.value("registered", false)) {
-                    cellj = c;
+        size_t primary = 0;
+        bool has_cells = j.contains("cells") && j["cells"].is_array() && !j["cells"].empty();
+        if (has_cells) {
+            const auto& cells = j["cells"];
+            for (size_t i = 0; i < cells.size(); i++) {
+                if (cells[i].value("registered", false)) {
+                    primary = i;
                     break;
                 }
             }
+            cellj = cells[primary];
         } else {
             // Backwards compatibility if a single cell is at top level
             cellj = j;
         }
 
-        // Extract identity
-        auto fullid = to_string(cellj, "full_cell_key");
-        if (fullid.empty())
-            fullid = to_string(cellj, "full_cell_id");
+        cell_fields f = read_cell(cellj);
+        if (f.fullid.empty())
+            return 0;
 
-        // Always build our composite ID <mcc><mnc>-<tac/lac>-<cid/full_cell_id>
-        auto mcc_s = to_string(cellj, "mcc");
-        auto mnc_s = to_string(cellj, "mnc");
-        auto tac_lac_s = cellj.contains("tac") ? to_string(cellj, "tac") : to_string(cellj, "lac");
-        auto cid_s = cellj.contains("full_cell_id") ? to_string(cellj, "full_cell_id") : to_string(cellj, "cid");
-        std::stringstream composite_ss;
-        composite_ss << mcc_s << mnc_s << "-" << tac_lac_s << "-" << cid_s;
-        std::string composite_id = composite_ss.str();
+        // Phone position, flat (Android app) or nested (SCHEMA.md)
+        const nlohmann::json *pos_src = j.contains("lat") ? &j :
+            (j.contains("location") && j["location"].is_object() ? &j["location"] : nullptr);
+        if (pos_src != nullptr && pos_src->contains("lat") && pos_src->contains("lon") &&
+                (*pos_src)["lat"].is_number() && (*pos_src)["lon"].is_number()) {
+            f.lat = (*pos_src)["lat"].get<double>();
+            f.lon = (*pos_src)["lon"].get<double>();
+            f.has_location = !(f.lat == 0 && f.lon == 0) &&
+                cell_tower_index::valid_position(f.lat, f.lon);
+            f.alt = pos_src->contains("alt_m") ? pos_src->value("alt_m", 0.0) : pos_src->value("alt", 0.0);
+            f.speed = pos_src->value("speed_mps", 0.0);
+            f.heading = pos_src->value("bearing_deg", 0.0);
+        }
 
-        if (fullid.empty()) {
-            fullid = composite_id;
+        // Log meta copy; frames folded into another source's update are
+        // still logged in full
+        auto meta = in_pack->fetch<packet_metablob>(pack_comp_meta);
+        if (meta == nullptr) {
+            meta = std::make_shared<packet_metablob>("cell", json->json_string);
+            in_pack->insert(pack_comp_meta, meta);
         }
-        if (fullid.empty())
+
+        auto tags = apply_cell(in_pack, f, source_name);
+        if (tags == nullptr)
             return 0;
 
-        // Build a stable locally-administered MAC from the id
+        // Add all primitive fields as cell.* tags for UI display (top-level + chosen cell)
+        auto add_tags = [&tags, &to_string](const nlohmann::json& obj) {
+            for (auto it = obj.begin(); it != obj.end(); ++it) {
+                if (it.value().is_null())
+                    continue;
+                if (it.value().is_primitive()) {
+                    auto key = std::string("cell.") + it.key();
+                    // Don't overwrite computed values
+                    if (tags->tagmap.find(key) == tags->tagmap.end()) {
+                        auto sval = to_string(obj, it.key());
+                        if (!sval.empty())
+                            tags->tagmap[key] = sval;
+                    }
+                }
+            }
+        };
+        add_tags(j);
+        add_tags(cellj);
+        metrics.tags_emitted(tags->tagmap.size());
+
+        // Neighbours the phone only gave a PCI and channel for are measurements
+        // of the serving cells they resolve to
+        if (has_cells && pci_cache != nullptr) {
+            auto pos = position_for(in_pack, f);
+            const auto& cells = j["cells"];
+            for (size_t i = 0; i < cells.size(); i++) {
+                if (i == primary || !cells[i].is_object() || cells[i].value("registered", false))
+                    continue;
+                auto nf = read_cell(cells[i]);
+                if (cell_pci_cache::unknown_id(nf.cid) || cell_pci_cache::unknown_id(nf.tac))
+                    apply_neighbour(in_pack, std::move(nf), pos);
+            }
+        }
+
+        return 1;
+    }
+
+    // Turn one observation into device, estimator, summary, aggregate and
+    // alert updates.  Returns the packet's tag component with the computed
+    // tags set, or nullptr if no device was updated: either none could be,
+    // or another source's observation of the same cell already was in this
+    // coalescing window.  Handover and alert checks run for every source.
+    std::shared_ptr<kis_devicetag_packetinfo> apply_cell(const std::shared_ptr<kis_packet>& in_pack,
+            cell_fields f, const std::string& source_name) {
+        const auto& composite_id = f.composite_id;
+        const auto& channel = f.channel;
+        uint64_t ts_ms = in_pack->ts.tv_sec * 1000ULL + in_pack->ts.tv_usec / 1000;
+
+        // Best available signal for estimators and summaries; Android reports
+        // unavailable measurements as INT_MAX
+        int sig = f.rsrp != 0 ? f.rsrp : f.rssi;
+        bool sig_valid = sig < 0 && sig > -200;
+
+        auto pos = position_for(in_pack, f);
+
+        // Before anything keys on the identity, which this may fill in
+        std::string resolved_from;
+        if (pci_cache != nullptr)
+            resolved_from = resolve_pci(f, pos, in_pack->ts.tv_sec);
+
         std::hash<std::string> h;
-        uint64_t hv = h(fullid);
-        uint8_t macbytes[6];
-        macbytes[0] = 0x02; // locally administered, unicast
-        macbytes[1] = (hv >> 32) & 0xFF;
-        macbytes[2] = (hv >> 24) & 0xFF;
-        macbytes[3] = (hv >> 16) & 0xFF;
-        macbytes[4] = (hv >> 8) & 0xFF;
-        macbytes[5] = hv & 0xFF;
-        mac_addr mac(macbytes, 6);
-
-        nlohmann::json arfcn = cellj.contains("nrarfcn") ? cellj["nrarfcn"] :
-                               (cellj.contains("earfcn") ? cellj["earfcn"] :
-                               (cellj.contains("arfcn") ? cellj["arfcn"] : nlohmann::json()));
-        std::string channel = "";
-        if (arfcn.is_number()) channel = fmt::format("{}", arfcn.get<int>());
-        else if (arfcn.is_string()) channel = arfcn.get<std::string>();
-        std::optional<int> earfcn_val = to_int(cellj, "nrarfcn");
-        if (!earfcn_val) earfcn_val = to_int(cellj, "earfcn");
-        if (!earfcn_val) earfcn_val = to_int(cellj, "arfcn");
-        std::optional<int> band_val = to_int(cellj, "band");
-        if (!band_val && earfcn_val)
-            band_val = derive_band(*earfcn_val);
-
-        auto rssi_j = cellj.contains("rssi") ? cellj["rssi"] : nlohmann::json();
-        int rssi = rssi_j.is_number() ? rssi_j.get<int>() : 0;
-        int rsrp = cellj.contains("rsrp") && cellj["rsrp"].is_number() ? cellj["rsrp"].get<int>() : 0;
-        if (rssi == 0 && rsrp != 0)
-            rssi = rsrp; // fall back so UI signal uses something meaningful
-        int rsrq = cellj.contains("rsrq") && cellj["rsrq"].is_number() ? cellj["rsrq"].get<int>() : 0;
-
-        auto common = in_pack->fetch_or_add<kis_common_info>(cell->pack_comp_common);
+        uint64_t hv = h(f.fullid);
+        auto mac = mac_for(hv);
+
+        auto rat_t = cell_aggregate_table::rat_from_string(f.rat);
+
+        std::shared_ptr<kis_devicetag_packetinfo> tags;
+        if (coalesce == nullptr || coalesce->observe(composite_id, source_name, sig_valid, sig, ts_ms)) {
+            tags = update_cell_device(in_pack, f, hv, mac, rat_t, sig_valid, sig, pos);
+            if (tags == nullptr)
+                return nullptr;
+            if (!resolved_from.empty()) {
+                // Keep add_tags from putting the phone's placeholders back
+                tags->tagmap["cell.mcc"] = f.mcc;
+                tags->tagmap["cell.mnc"] = f.mnc;
+                tags->tagmap["cell.tac"] = f.tac;
+                tags->tagmap["cell.cid"] = f.cid;
+                tags->tagmap["cell.resolved_from"] = resolved_from;
+            }
+        } else {
+            metrics.coalesced();
+        }
+
+        if (f.registered)
+            handovers->observe(source_name, composite_id, rat_t, sig_valid, sig,
+                    pos.has_location, pos.lat, pos.lon, ts_ms);
+
+        // Inline anomaly checks; skipped when the frame lacks a real numeric
+        // CID.  Android's "unavailable" placeholder would otherwise make
+        // every partial neighbour the same fake cell.
+        char *cid_end = nullptr;
+        uint64_t cid_num = std::strtoull(f.cid.c_str(), &cid_end, 10);
+        if (!cell_pci_cache::unknown_id(f.cid) && cid_end != nullptr && *cid_end == '\0') {
+            cell_anomaly_detector::observation obs;
+            obs.plmn_rat = cell_aggregate_table::make_key(f.mcc, f.mnc, rat_t, 0);
+            obs.rat = rat_t;
+            obs.cid = cid_num;
+            char *num_end = nullptr;
+            long tac = std::strtol(f.tac.c_str(), &num_end, 10);
+            if (!f.tac.empty() && *num_end == '\0' && tac >= 0 && tac < INT_MAX) {
+                obs.has_tac = true;
+                obs.tac = tac;
+            }
+            long pci = std::strtol(f.pci.c_str(), &num_end, 10);
+            if (!f.pci.empty() && *num_end == '\0' && pci >= 0 && pci < INT_MAX && f.earfcn) {
+                obs.has_pci = true;
+                obs.pci = pci;
+                obs.arfcn = *f.earfcn;
+            }
+            obs.has_signal = sig_valid;
+            obs.signal_dbm = sig;
+            obs.serving = f.registered;
+            obs.ts_sec = in_pack->ts.tv_sec;
+            obs.has_position = pos.has_location;
+            obs.lat = pos.lat;
+            obs.lon = pos.lon;
+
+            std::vector<cell_anomaly_detector::anomaly> found;
+            anomalies->observe(source_name, obs, found);
+            for (const auto& a : found) {
+                auto ref = alert_refs[a.type];
+                if (!alertracker->potential_alert(ref))
+                    continue;
+                alertracker->raise_alert(ref, in_pack, mac_addr(0), mac, mac_addr(0),
+                        mac_addr(0), channel, fmt::format("{}: {}", composite_id, a.text));
+            }
+        }
+
+        return tags;
+    }
+
+    // Phone position for one frame
+    struct phone_position {
+        bool has_location = false;
+        bool from_nmea = false;     // already on the packet as helper GPS
+        double lat = 0, lon = 0;
+    };
+
+    // A fix the helper interpolated from the phone NMEA feed to this frame's
+    // timestamp beats the JSON copy, which is only as fresh as the phone's
+    // last location callback
+    phone_position position_for(const std::shared_ptr<kis_packet>& in_pack, const cell_fields& f) {
+        phone_position pos;
+        pos.has_location = f.has_location;
+        pos.lat = f.lat;
+        pos.lon = f.lon;
+        auto pkt_gps = in_pack->fetch<kis_gps_packinfo>(pack_comp_gps);
+        if (pkt_gps != nullptr && pkt_gps->gpsname == "phone-nmea" && pkt_gps->fix >= 2) {
+            pos.has_location = pos.from_nmea = true;
+            pos.lat = pkt_gps->lat;
+            pos.lon = pkt_gps->lon;
+        }
+        return pos;
+    }
+
+    // A partial neighbour: if the PCI cache resolves it to a cell that is in
+    // memory, fold its signal and the phone position into that cell's record,
+    // transmitter estimate and summary row.  The frame's packet belongs to the
+    // primary cell, so neither the Kismet device's packet counts nor its tags
+    // change; neighbours don't teach the cache, count as handovers, or go
+    // through the anomaly checks, which would only see the cache's own answer.
+    // A spilled cell stays on disk until it is heard as a primary cell again.
+    void apply_neighbour(const std::shared_ptr<kis_packet>& in_pack, cell_fields f,
+            const phone_position& pos) {
+        if (resolve_pci(f, pos, in_pack->ts.tv_sec).empty())
+            return;
+
+        int sig = f.rsrp != 0 ? f.rsrp : f.rssi;
+        bool sig_valid = sig < 0 && sig > -200;
+
+        // Same ordering as update_cell_device: the spill lock keeps the sweep
+        // from moving the cell out while it's being updated
+        std::shared_lock<std::shared_mutex> spill_lk(spill_lock, std::defer_lock);
+        if (spill != nullptr)
+            spill_lk.lock();
+
+        if (!summary.contains(f.composite_id))
+            return;
+
+        std::hash<std::string> h;
+        auto hv = h(f.fullid);
+
+        {
+            kis_lock_guard<kis_mutex> dev_lk(devicetracker->get_devicelist_mutex(), "cell apply_neighbour");
+            auto basedev = devicetracker->fetch_device(device_key(fetch_phyname_hash(), mac_for(hv)));
+            auto celldev = basedev != nullptr ? basedev->get_sub_as<cell_tracked_common>(cell_common_id) : nullptr;
+            if (celldev != nullptr) {
+                // Heard, so not idle as far as Kismet's device timeout goes
+                basedev->set_last_time(in_pack->ts.tv_sec);
+                if (sig_valid) {
+                    celldev->set_rssi(fmt::format("{}", f.rssi));
+                    celldev->set_rsrp(fmt::format("{}", f.rsrp));
+                    celldev->set_rsrq(fmt::format("{}", f.rsrq));
+                }
+            }
+
+            if (pos.has_location) {
+                // Timing advance is only kept for the serving cell
+                auto est = towers.observe(f.composite_id, pos.lat, pos.lon, sig_valid, sig, -1);
+                if (celldev != nullptr) {
+                    celldev->set_tower_lat(est.lat);
+                    celldev->set_tower_lon(est.lon);
+                    celldev->set_tower_radius_m(est.radius_m);
+                    celldev->set_tower_samples(est.samples);
+                }
+            }
+        }
+
+        auto tower_est = towers.estimate(f.composite_id);
+        summary.update(f.composite_id, in_pack->ts.tv_sec + in_pack->ts.tv_usec / 1000000.0,
+                [&](cell_summary_row& row) {
+                    if (sig_valid) {
+                        if (!row.has_signal || sig > row.best_signal)
+                            row.best_signal = sig;
+                        row.signal = sig;
+                        row.has_signal = true;
+                    }
+                    if (tower_est) {
+                        row.has_tower = true;
+                        row.tower_lat = tower_est->lat;
+                        row.tower_lon = tower_est->lon;
+                    }
+                });
+    }
+
+    // Teach the PCI cache from a fully identified serving cell, or fill in a
+    // partial cell's identity from it.  Only LTE and NR have a PCI; GSM and
+    // WCDMA report BSIC / PSC instead.  Returns "pci P @ arfcn A" if f was
+    // resolved, empty otherwise.
+    std::string resolve_pci(cell_fields& f, const phone_position& pos, uint64_t now) {
+        if ((f.rat != "LTE" && f.rat != "NR") || !f.earfcn || f.pci.empty())
+            return "";
+
+        char *num_end = nullptr;
+        long pci = std::strtol(f.pci.c_str(), &num_end, 10);
+        if (*num_end != '\0' || pci < 0 || pci >= INT_MAX)
+            return "";
+
+        bool unknown = cell_pci_cache::unknown_id(f.cid) || cell_pci_cache::unknown_id(f.tac);
+
+        if (!unknown) {
+            if (f.registered && pci_cache->learn(f.rat, *f.earfcn, pci,
+                        {f.mcc, f.mnc, f.tac, f.cid, f.fullid},
+                        pos.has_location, pos.lat, pos.lon, now))
+                metrics.pci_cache_size(pci_cache->size());
+            return "";
+        }
+
+        auto mcc = cell_pci_cache::unknown_id(f.mcc) ? std::string() : f.mcc;
+        auto mnc = cell_pci_cache::unknown_id(f.mnc) ? std::string() : f.mnc;
+        auto id = pci_cache->lookup(mcc, mnc, f.rat, *f.earfcn, pci,
+                pos.has_location, pos.lat, pos.lon, now);
+        if (!id) {
+            metrics.pci_unresolved();
+            return "";
+        }
+
+        metrics.pci_resolved();
+        f.mcc = id->mcc;
+        f.mnc = id->mnc;
+        f.tac = id->tac;
+        f.cid = id->cid;
+        f.composite_id = f.mcc + f.mnc + "-" + f.tac + "-" + f.cid;
+        f.fullid = id->fullid.empty() ? f.composite_id : id->fullid;
+
+        return fmt::format("pci {} @ arfcn {}", pci, *f.earfcn);
+    }
+
+    // The once-per-window part of apply_cell: the Kismet device and its cell
+    // record, transmitter estimate, summary row, aggregates and tags
+    std::shared_ptr<kis_devicetag_packetinfo> update_cell_device(const std::shared_ptr<kis_packet>& in_pack,
+            const cell_fields& f, uint64_t hv, const mac_addr& mac,
+            cell_aggregate_table::rat_type rat_t, bool sig_valid, int sig,
+            const phone_position& pos) {
+        const auto& composite_id = f.composite_id;
+        const auto& channel = f.channel;
+
+        auto common = in_pack->fetch_or_add<kis_common_info>(pack_comp_common);
         common->type = packet_basic_data;
-        common->phyid = cell->fetch_phy_id();
+        common->phyid = fetch_phy_id();
         common->datasize = 0;
         common->channel = channel;
         common->source = mac;
         common->transmitter = mac;
 
-        auto l1 = in_pack->fetch_or_add<kis_layer1_packinfo>(cell->pack_comp_radiodata);
+        auto l1 = in_pack->fetch_or_add<kis_layer1_packinfo>(pack_comp_radiodata);
         l1->signal_type = kis_l1_signal_type_dbm;
-        l1->signal_dbm = rssi;
-        l1->signal_rssi = rssi;
+        l1->signal_dbm = f.rssi;
+        l1->signal_rssi = f.rssi;
 
-        // GPS if present
-        if (j.contains("lat") && j.contains("lon")) {
-            auto gps = in_pack->fetch_or_add<kis_gps_packinfo>(cell->pack_comp_gps);
+        if (!pos.from_nmea && f.has_location) {
+            auto gps = in_pack->fetch_or_add<kis_gps_packinfo>(pack_comp_gps);
             gps->merge_partial = true;
             gps->merge_flags = GPS_PACKINFO_MERGE_LOC | GPS_PACKINFO_MERGE_ALT |
                                GPS_PACKINFO_MERGE_SPEED | GPS_PACKINFO_MERGE_HEADING;
-            gps->lat = j.value("lat", 0.0);
-            gps->lon = j.value("lon", 0.0);
-            gps->alt = j.value("alt_m", 0.0);
-            gps->speed = j.value("speed_mps", 0.0);
-            gps->heading = j.value("bearing_deg", 0.0);
+            gps->lat = f.lat;
+            gps->lon = f.lon;
+            gps->alt = f.alt;
+            gps->speed = f.speed;
+            gps->heading = f.heading;
             gps->fix = 3;
             gettimeofday(&(gps->tv), NULL);
         }
 
+        // Frames hold the spill lock shared from before they touch the device
+        // until their summary row exists, so a sweep can neither strip the
+        // cell record out from under them nor move the cell out half-updated
+        std::shared_lock<std::shared_mutex> spill_lk(spill_lock, std::defer_lock);
+        if (spill != nullptr)
+            spill_lk.lock();
+
         // Update base device
-        auto basedev = cell->devicetracker->update_common_device(common, common->source, cell,
+        auto basedev = devicetracker->update_common_device(common, common->source, this,
                 in_pack, (UCD_UPDATE_FREQUENCIES | UCD_UPDATE_PACKETS |
                           UCD_UPDATE_LOCATION | UCD_UPDATE_SEENBY), "Cell");
         if (basedev == nullptr)
-            return 0;
+            return nullptr;
+
+        // A cell that was moved out of memory while idle is read back before
+        // the devicelist lock is taken.  restore_lk is held until the summary
+        // row exists again, so a second frame for the cell can't recall it
+        // from the snapshot while this one holds its spilled state.
+        std::unique_lock<std::mutex> restore_lk(restore_mutex, std::defer_lock);
+        std::string spilled;
+        bool have_spilled = false;
+        bool try_recall = false;
+        if ((spill != nullptr || kb != nullptr) && !summary.contains(composite_id)) {
+            restore_lk.lock();
+            if (!summary.contains(composite_id)) {
+                have_spilled = spill != nullptr && spill->take(composite_id, spilled);
+                try_recall = !have_spilled && kb != nullptr;
+            } else {
+                restore_lk.unlock();
+            }
+        }
+
+        // The device and its cell record are read by the HTTP serializers
+        kis_unique_lock<kis_mutex> dev_lk(devicetracker->get_devicelist_mutex(), "cell update_cell_device");
 
         basedev->set_devicename(composite_id);
         basedev->set_commonname(composite_id);
-        basedev->set_tracker_type_string(cell->devicetracker->get_cached_devicetype("Cell"));
+        basedev->set_tracker_type_string(devicetracker->get_cached_devicetype("Cell"));
         if (!channel.empty())
             basedev->set_channel(channel);
 
         // Attach cell-specific info
-        auto celldev = basedev->get_sub_as<cell_tracked_common>(cell->cell_common_id);
+        auto celldev = basedev->get_sub_as<cell_tracked_common>(cell_common_id);
         if (celldev == nullptr) {
-            celldev = Globalreg::globalreg->entrytracker->get_shared_instance_as<cell_tracked_common>(cell->cell_common_id);
+            celldev = Globalreg::globalreg->entrytracker->get_shared_instance_as<cell_tracked_common>(cell_common_id);
             basedev->insert(celldev);
         }
         celldev->set_fullid(composite_id);
-        celldev->set_rat(to_string(cellj, "rat"));
-        celldev->set_mcc(to_string(cellj, "mcc"));
-        celldev->set_mnc(to_string(cellj, "mnc"));
-        celldev->set_tac(cellj.contains("tac") ? to_string(cellj, "tac") : to_string(cellj, "lac"));
-        celldev->set_cid(cellj.contains("full_cell_id") ? to_string(cellj, "full_cell_id") : to_string(cellj, "cid"));
+        celldev->set_rat(f.rat);
+        celldev->set_mcc(f.mcc);
+        celldev->set_mnc(f.mnc);
+        celldev->set_tac(f.tac);
+        celldev->set_cid(f.cid);
         celldev->set_arfcn(channel);
-        celldev->set_pci(to_string(cellj, "pci"));
-        celldev->set_rssi(fmt::format("{}", rssi));
-        celldev->set_rsrp(fmt::format("{}", rsrp));
-        celldev->set_rsrq(fmt::format("{}", rsrq));
-        if (band_val)
-            celldev->set_band(fmt::format("{}", *band_val));
-        else
-            celldev->set_band(to_string(cellj, "band"));
-
-        // Compute DL/UL if missing
-        std::optional<double> dl_freq, ul_freq;
-        if (earfcn_val && band_val) {
-            auto bi = lte_bands.find(*band_val);
-            if (bi != lte_bands.end()) {
-                const auto& info = bi->second;
-                dl_freq = info.fdl_low + 0.1 * (*earfcn_val - info.n_offs);
-                if (info.ful_low)
-                    ul_freq = *(info.ful_low) + 0.1 * (*earfcn_val - info.n_offs);
+        celldev->set_pci(f.pci);
+        celldev->set_rssi(fmt::format("{}", f.rssi));
+        celldev->set_rsrp(fmt::format("{}", f.rsrp));
+        celldev->set_rsrq(fmt::format("{}", f.rsrq));
+        celldev->set_band(f.band);
+
+        // A spilled cell, or one that an earlier run knew, gets its state
+        // back before this frame is folded in.  The restored row hides from
+        // summary.update that an earlier run's cell is new to this one.
+        std::vector<std::pair<std::string, std::string>> restored_tags;
+        bool from_earlier_run = false;
+        if (have_spilled)
+            from_earlier_run = !restore_cell(composite_id, spilled, celldev, restored_tags);
+        else if (try_recall)
+            from_earlier_run = recall_cell(composite_id, celldev);
+
+        // Fold into the running transmitter estimate
+        if (pos.has_location) {
+            double ta_m = -1;
+            if (f.timing_advance)
+                ta_m = cell_tower_index::ta_distance_m(f.rat, *f.timing_advance);
+            auto est = towers.observe(composite_id, pos.lat, pos.lon, sig_valid, sig, ta_m);
+            celldev->set_tower_lat(est.lat);
+            celldev->set_tower_lon(est.lon);
+            celldev->set_tower_radius_m(est.radius_m);
+            celldev->set_tower_samples(est.samples);
+        }
+        dev_lk.unlock();
+
+        if (restore_lk.owns_lock())
+            restore_lk.unlock();
+
+        if (pos.has_location) {
+            if (heatmap != nullptr) {
+                int band = f.band_num ? *f.band_num : 0;
+                heatmap->observe(cell_aggregate_table::make_key(f.mcc, f.mnc, rat_t, band), hv,
+                        f.mcc, f.mnc, f.rat, band, composite_id,
+                        pos.lat, pos.lon, sig_valid, sig, in_pack->ts.tv_sec);
+                size_t held;
+                uint64_t evicted;
+                heatmap->stats(held, evicted);
+                metrics.heatmap_sizes(held, evicted);
             }
         }
 
-        // Add all primitive fields as cell.* tags for UI display (top-level + chosen cell)
-        auto tags = in_pack->fetch_or_add<kis_devicetag_packetinfo>(cell->pack_comp_devicetag);
+        // Keep the polled summary row in step with the device record
+        auto tower_est = towers.estimate(composite_id);
+        bool new_cell = summary.update(composite_id, in_pack->ts.tv_sec + in_pack->ts.tv_usec / 1000000.0,
+                [&](cell_summary_row& row) {
+                    row.rat = f.rat;
+                    row.mcc = f.mcc;
+                    row.mnc = f.mnc;
+                    row.tac = f.tac;
+                    row.cid = f.cid;
+                    row.pci = f.pci;
+                    row.arfcn = channel;
+                    row.band = f.band;
+                    row.device_hash = hv;
+                    if (sig_valid) {
+                        if (!row.has_signal || sig > row.best_signal)
+                            row.best_signal = sig;
+                        row.signal = sig;
+                        row.has_signal = true;
+                    }
+                    if (tower_est) {
+                        row.has_tower = true;
+                        row.tower_lat = tower_est->lat;
+                        row.tower_lon = tower_est->lon;
+                    }
+                });
+
+        if (spill_lk.owns_lock())
+            spill_lk.unlock();
+
+        // Distinct cells and devices created count per run
+        bool first_this_run = new_cell || from_earlier_run;
+        aggregates.observe(
+                cell_aggregate_table::make_key(f.mcc, f.mnc, rat_t, f.band_num ? *f.band_num : 0),
+                hv, first_this_run, sig_valid, sig, in_pack->ts.tv_sec);
+        if (first_this_run)
+            metrics.device_created();
+
+        auto tags = in_pack->fetch_or_add<kis_devicetag_packetinfo>(pack_comp_devicetag);
         tags->tagmap["cell.full_composite"] = composite_id;
-        if (band_val)
-            tags->tagmap["cell.band"] = fmt::format("{}", *band_val);
-        if (dl_freq)
-            tags->tagmap["cell.dl_freq_mhz"] = fmt::format("{:.3f}", *dl_freq);
-        if (ul_freq)
-            tags->tagmap["cell.ul_freq_mhz"] = fmt::format("{:.3f}", *ul_freq);
-        auto add_tags = [&tags, &to_string](const nlohmann::json& obj) {
-            for (auto it = obj.begin(); it != obj.end(); ++it) {
-                if (it.value().is_null())
+        if (f.band_num)
+            tags->tagmap["cell.band"] = fmt::format("{}", *f.band_num);
+        if (f.dl_freq)
+            tags->tagmap["cell.dl_freq_mhz"] = fmt::format("{:.3f}", *f.dl_freq);
+        if (f.ul_freq)
+            tags->tagmap["cell.ul_freq_mhz"] = fmt::format("{:.3f}", *f.ul_freq);
+
+        // Tags the device carried before it was compacted; anything this frame
+        // sets is newer
+        for (auto& t : restored_tags)
+            tags->tagmap.emplace(std::move(t.first), std::move(t.second));
+
+        // What each phone heard of this cell lately, as last/best dBm; the
+        // frames folded into the window only land here
+        if (coalesce != nullptr) {
+            std::string per_source;
+            for (const auto& s : coalesce->sources(composite_id)) {
+                if (!s.second.has_signal)
                     continue;
-                if (it.value().is_primitive()) {
-                    auto key = std::string("cell.") + it.key();
-                    // Don't overwrite computed values
-                    if (tags->tagmap.find(key) == tags->tagmap.end()) {
-                        auto sval = to_string(obj, it.key());
-                        if (!sval.empty())
-                            tags->tagmap[key] = sval;
+                if (!per_source.empty())
+                    per_source += ", ";
+                per_source += fmt::format("{} {}/{}", s.first, s.second.last_signal, s.second.best_signal);
+            }
+            if (!per_source.empty())
+                tags->tagmap["cell.source_signals"] = per_source;
+        }
+
+        return tags;
+    }
+
+    // Stable locally-administered MAC for a cell id hash
+    static mac_addr mac_for(uint64_t hv) {
+        uint8_t macbytes[6];
+        macbytes[0] = 0x02; // locally administered, unicast
+        macbytes[1] = (hv >> 32) & 0xFF;
+        macbytes[2] = (hv >> 24) & 0xFF;
+        macbytes[3] = (hv >> 16) & 0xFF;
+        macbytes[4] = (hv >> 8) & 0xFF;
+        macbytes[5] = hv & 0xFF;
+        return mac_addr(macbytes, 6);
+    }
+
+    // Move cells not heard for spill_idle_secs out of memory: the summary row,
+    // tower sums and device tags go to the spill store, and the Kismet device
+    // is stripped of its cell record and tags; Kismet's device timeout drops
+    // the rest of it, and update_common_device makes a new one on restore.  Runs on a timer every
+    // spill_sweep_secs; the spill lock is taken a bounded batch at a time so
+    // frames are held up for one batch at most, and the store is compacted
+    // once the batches are done.
+    void spill_idle_cells() {
+        while (spill_batch_idle(time(0)) == spill_batch)
+            ;
+        // Outside the spill lock; only frames restoring a cell wait on it
+        spill->compact();
+        metrics.spill_sizes(summary.size(), spill->size(), spill->file_bytes());
+    }
+
+    // One batch of spill_idle_cells; returns how many cells were idle, or 0
+    // if the store refused one, so a failing disk doesn't spin the sweep
+    size_t spill_batch_idle(time_t now) {
+        std::unique_lock<std::shared_mutex> lk(spill_lock);
+
+        std::vector<cell_summary_row> idle;
+        auto n = summary.take_idle(now - spill_idle_secs, spill_batch, idle);
+
+        for (auto& row : idle) {
+            nlohmann::json rec = {
+                {"rat", row.rat}, {"mcc", row.mcc}, {"mnc", row.mnc}, {"tac", row.tac},
+                {"cid", row.cid}, {"pci", row.pci}, {"arfcn", row.arfcn}, {"band", row.band},
+                {"first_seen", row.first_seen}, {"last_seen", row.last_seen},
+                {"packets", row.packets}, {"device_hash", row.device_hash},
+                {"run", run_id},
+            };
+            if (row.has_signal) {
+                rec["signal"] = row.signal;
+                rec["best_signal"] = row.best_signal;
+            }
+
+            cell_tower_index::tower_state tower;
+            bool has_tower = towers.take(row.key, tower);
+            if (has_tower)
+                rec["tower"] = cell_tower_index::pack(tower);
+
+            // The record is built under the devicelist lock and written after
+            // it's dropped; frames for this cell are held off by the spill lock
+            std::shared_ptr<kis_tracked_device_base> dev;
+            {
+                kis_lock_guard<kis_mutex> dev_lk(devicetracker->get_devicelist_mutex(), "cell spill_idle_cells");
+                dev = devicetracker->fetch_device(device_key(fetch_phyname_hash(), mac_for(row.device_hash)));
+                auto tagmap = dev != nullptr ? dev->get_tag_map() : nullptr;
+                if (tagmap != nullptr) {
+                    auto& tags = rec["tags"] = nlohmann::json::object();
+                    for (const auto& t : *tagmap) {
+                        auto ts = std::dynamic_pointer_cast<tracker_element_string>(t.second);
+                        if (ts != nullptr)
+                            tags[t.first] = ts->get();
                     }
                 }
             }
-        };
-        add_tags(j);
-        add_tags(cellj);
 
-        // Log meta copy
-        auto meta = in_pack->fetch<packet_metablob>(cell->pack_comp_meta);
-        if (meta == nullptr) {
-            meta = std::make_shared<packet_metablob>("cell", json->json_string);
-            in_pack->insert(cell->pack_comp_meta, meta);
+            if (!spill->put(row.key, rec.dump())) {
+                // Couldn't write it out; keep it in memory
+                if (has_tower)
+                    towers.put(row.key, tower);
+                summary.restore(std::move(row));
+                n = 0;
+                continue;
+            }
+
+            // Keep the compact record for the next snapshot
+            if (kb != nullptr) {
+                auto rec = cell_kb::make_record(row,
+                        has_tower ? std::make_optional(tower.est) : std::nullopt);
+                if (rec)
+                    kb->retain(*rec);
+            }
+
+            if (dev != nullptr) {
+                kis_lock_guard<kis_mutex> dev_lk(devicetracker->get_devicelist_mutex(), "cell spill_idle_cells");
+                dev->erase(cell_common_id);
+                auto tagmap = dev->get_tag_map();
+                if (tagmap != nullptr)
+                    tagmap->clear();
+            }
+
+            metrics.cell_spilled();
         }
 
-        return 1;
+        return n;
+    }
+
+    // First sighting this run of a cell a previous run knew; seed the summary
+    // row and transmitter estimate from the mapped snapshot.  Returns whether
+    // the snapshot had the cell.
+    bool recall_cell(const std::string& key, const std::shared_ptr<cell_tracked_common>& celldev) {
+        auto rec = kb->lookup(key);
+        if (!rec)
+            return false;
+
+        auto est = cell_kb::to_estimate(*rec);
+        if (est) {
+            towers.restore(key, *est);
+            celldev->set_tower_lat(est->lat);
+            celldev->set_tower_lon(est->lon);
+            celldev->set_tower_radius_m(est->radius_m);
+            celldev->set_tower_samples(est->samples);
+        }
+
+        summary.restore(cell_kb::to_row(*rec));
+        metrics.kb_recalled();
+        return true;
+    }
+
+    // Write the knowledge snapshot: every live cell merged into what the
+    // mapped snapshot already holds.  Runs on the timer and at shutdown.
+    void save_kb() {
+        std::vector<cell_summary_row> rows;
+        summary.for_each([&](const cell_summary_row& row) { rows.push_back(row); });
+
+        std::vector<cell_kb::record> live;
+        live.reserve(rows.size());
+        for (const auto& row : rows) {
+            auto rec = cell_kb::make_record(row, towers.estimate(row.key));
+            if (rec)
+                live.push_back(*rec);
+        }
+
+        std::string err;
+        if (!kb->save(std::move(live), err))
+            _MSG("cell: unable to save known cells; " + err, MSGFLAG_ERROR);
+        metrics.kb_size(kb->size());
+    }
+
+    // Reinstate a spilled cell; tags the device had are handed back in tags
+    // so they can be merged into the current frame's.  Returns whether this
+    // run spilled it, as opposed to one before a restart.
+    bool restore_cell(const std::string& key, const std::string& payload,
+            const std::shared_ptr<cell_tracked_common>& celldev,
+            std::vector<std::pair<std::string, std::string>>& tags) {
+        bool this_run = false;
+        try {
+            auto rec = nlohmann::json::parse(payload);
+            this_run = rec.value("run", uint64_t{0}) == run_id;
+
+            cell_summary_row row;
+            row.key = key;
+            row.rat = rec.value("rat", "");
+            row.mcc = rec.value("mcc", "");
+            row.mnc = rec.value("mnc", "");
+            row.tac = rec.value("tac", "");
+            row.cid = rec.value("cid", "");
+            row.pci = rec.value("pci", "");
+            row.arfcn = rec.value("arfcn", "");
+            row.band = rec.value("band", "");
+            row.first_seen = rec.value("first_seen", 0.0);
+            row.last_seen = rec.value("last_seen", 0.0);
+            row.packets = rec.value("packets", uint64_t{0});
+            row.device_hash = rec.value("device_hash", uint64_t{0});
+            if (rec.contains("signal")) {
+                row.has_signal = true;
+                row.signal = rec["signal"].get<int>();
+                row.best_signal = rec.value("best_signal", row.signal);
+            }
+
+            cell_tower_index::tower_state tower;
+            if (rec.contains("tower") &&
+                    cell_tower_index::unpack(rec["tower"].get<std::vector<double>>(), tower)) {
+                towers.put(key, tower);
+                if (tower.est.samples > 0) {
+                    row.has_tower = true;
+                    row.tower_lat = tower.est.lat;
+                    row.tower_lon = tower.est.lon;
+                    celldev->set_tower_lat(tower.est.lat);
+                    celldev->set_tower_lon(tower.est.lon);
+                    celldev->set_tower_radius_m(tower.est.radius_m);
+                    celldev->set_tower_samples(tower.est.samples);
+                }
+            }
+
+            summary.restore(std::move(row));
+
+            if (rec.contains("tags"))
+                for (const auto& t : rec["tags"].items())
+                    if (t.value().is_string())
+                        tags.emplace_back(t.key(), t.value().get<std::string>());
+        } catch (const std::exception& e) {
+            _MSG("cell: unable to restore spilled cell " + key + ": " + e.what(), MSGFLAG_ERROR);
+            return false;
+        }
+
+        metrics.cell_restored();
+        metrics.spill_sizes(summary.size(), spill->size(), spill->file_bytes());
+        return this_run;
     }
 
 private:
     std::shared_ptr<packet_chain> packetchain;
     std::shared_ptr<entry_tracker> entrytracker;
     std::shared_ptr<device_tracker> devicetracker;
+    std::shared_ptr<kis_net_beast_httpd> httpd;
+    std::shared_ptr<alert_tracker> alertracker;
+
+    cell_tower_index towers;
+    cell_summary_table summary;
+    cell_aggregate_table aggregates;
+    cell_metrics metrics;
+    std::unique_ptr<cell_anomaly_detector> anomalies;
+    std::unique_ptr<cell_handover_tracker> handovers;
+
+    // Cross-source coalescing window; null when disabled
+    std::unique_ptr<cell_coalescer> coalesce;
+
+    // Live coverage bins; null when disabled
+    std::unique_ptr<cell_heatmap> heatmap;
+
+    // Partial cell resolution; null when disabled
+    std::unique_ptr<cell_pci_cache> pci_cache;
+
+    // Warm-start snapshot; kb is null when disabled
+    std::unique_ptr<cell_kb> kb;
+    std::shared_ptr<time_tracker> timetracker;
+    int kb_timer = -1;
+
+    // Idle cell eviction; spill is null when disabled
+    static constexpr size_t spill_batch = 256;
+    static constexpr time_t spill_sweep_secs = 30;
+    std::unique_ptr<cell_spill_store> spill;
+    unsigned int spill_idle_secs = 0;
+    int spill_timer = -1;
+    std::shared_mutex spill_lock;
+    // Held from taking a cell's spilled state until its summary row is back
+    std::mutex restore_mutex;
+    // Written into spill records to tell this run's from an earlier one's
+    const uint64_t run_id = (uint64_t{std::random_device{}()} << 32) | std::random_device{}();
+    std::array<int, cell_anomaly_detector::num_types> alert_refs{};
 
     int pack_comp_common = -1;
     int pack_comp_json = -1;
@@ -424,6 +1675,11 @@ private:
     int pack_comp_radiodata = -1;
     int pack_comp_gps = -1;
     int pack_comp_devicetag = -1;
+    int pack_comp_datasrc = -1;
+    int pack_comp_linkframe = -1;
+
+    // Attach a rebuilt JSON metablob to helper records for the log
+    bool log_record_meta = false;
 
     int cell_common_id = -1;
 };
@@ -490,7 +1746,7 @@ extern "C" {
 
             // Register the cell PHY so JSON frames get turned into devices
             auto devicetracker = Globalreg::fetch_mandatory_global_as<device_tracker>();
-            devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new kis_cell_phy(0)));
+            devicetracker->register_phy_handler(dynamic_cast<kis_phy_handler *>(new kis_cell_phy()));
 
             // Register UI module to render cell fields in the device details panel
             auto httpregistry = Globalreg::fetch_mandatory_global_as<kis_httpd_registry>();
@@ -0,0 +1,248 @@
+/*
+ * On-disk store for idle cells; see cell_spill.h
+ */
+
+#include "cell_spill.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+    // Don't bother rewriting small files
+    constexpr uint64_t compact_min_bytes = 1 << 20;
+
+    bool write_all(int fd, const char *data, size_t len) {
+        while (len > 0) {
+            auto r = write(fd, data, len);
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += r;
+            len -= r;
+        }
+        return true;
+    }
+}
+
+cell_spill_store::~cell_spill_store() {
+    if (fd >= 0)
+        close(fd);
+}
+
+bool cell_spill_store::open(const std::string& in_path, std::string& err) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    index.clear();
+    end_offset = live_bytes = 0;
+
+    int nfd = ::open(in_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+    if (nfd < 0) {
+        err = std::string("unable to open ") + in_path + ": " + strerror(errno);
+        return false;
+    }
+
+    std::ifstream ifs(in_path, std::ios::binary);
+    std::string line;
+    uint64_t offset = 0;
+
+    while (std::getline(ifs, line)) {
+        // No newline: the last write was cut short
+        if (ifs.eof())
+            break;
+
+        uint64_t length = line.size() + 1;
+
+        try {
+            auto j = nlohmann::json::parse(line);
+            const auto& key = j.at("key").get_ref<const std::string&>();
+
+            auto ii = index.find(key);
+            if (ii != index.end()) {
+                live_bytes -= ii->second.length;
+                index.erase(ii);
+            }
+
+            if (j.contains("cell")) {
+                index[key] = entry{offset, static_cast<uint32_t>(length)};
+                live_bytes += length;
+            }
+        } catch (const std::exception&) {
+            // Unreadable line; it's dead space until the next compaction
+        }
+
+        offset += length;
+    }
+
+    if (ftruncate(nfd, offset) < 0) {
+        err = std::string("unable to truncate ") + in_path + ": " + strerror(errno);
+        close(nfd);
+        index.clear();
+        live_bytes = 0;
+        return false;
+    }
+
+    fd = nfd;
+    path = in_path;
+    end_offset = offset;
+
+    compact_locked();
+
+    return true;
+}
+
+bool cell_spill_store::is_open() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return fd >= 0;
+}
+
+bool cell_spill_store::append_locked(const std::string& line, uint64_t& offset) {
+    if (fd < 0)
+        return false;
+
+    offset = end_offset;
+    if (!write_all(fd, line.data(), line.size())) {
+        // Drop whatever part made it out so the file stays line-aligned
+        if (ftruncate(fd, end_offset) < 0) { }
+        return false;
+    }
+
+    end_offset += line.size();
+    return true;
+}
+
+bool cell_spill_store::read_locked(const entry& e, std::string& line) const {
+    line.resize(e.length);
+
+    size_t got = 0;
+    while (got < e.length) {
+        auto r = pread(fd, &line[got], e.length - got, e.offset + got);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        got += r;
+    }
+
+    return true;
+}
+
+bool cell_spill_store::put(const std::string& key, const std::string& payload) {
+    std::string line = "{\"key\":" + nlohmann::json(key).dump() + ",\"cell\":" + payload + "}\n";
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    uint64_t offset;
+    if (!append_locked(line, offset))
+        return false;
+
+    auto& e = index[key];
+    live_bytes -= e.length;
+    e = entry{offset, static_cast<uint32_t>(line.size())};
+    live_bytes += e.length;
+
+    return true;
+}
+
+bool cell_spill_store::take(const std::string& key, std::string& payload) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    auto ii = index.find(key);
+    if (ii == index.end())
+        return false;
+
+    std::string line;
+    bool ok = read_locked(ii->second, line);
+    if (ok) {
+        try {
+            payload = nlohmann::json::parse(line).at("cell").dump();
+        } catch (const std::exception&) {
+            ok = false;
+        }
+    }
+
+    // Mark it taken either way; an unreadable record is no use on the next
+    // sighting either
+    uint64_t offset;
+    append_locked("{\"key\":" + nlohmann::json(key).dump() + ",\"taken\":true}\n", offset);
+
+    live_bytes -= ii->second.length;
+    index.erase(ii);
+
+    return ok;
+}
+
+size_t cell_spill_store::size() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return index.size();
+}
+
+uint64_t cell_spill_store::file_bytes() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return end_offset;
+}
+
+void cell_spill_store::compact() {
+    std::lock_guard<std::mutex> lk(mutex);
+    compact_locked();
+}
+
+void cell_spill_store::compact_locked() {
+    if (fd < 0 || end_offset < compact_min_bytes || live_bytes * 2 > end_offset)
+        return;
+
+    std::string tmp_path = path + ".tmp";
+    int tfd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (tfd < 0)
+        return;
+
+    std::unordered_map<std::string, entry> new_index;
+    new_index.reserve(index.size());
+    uint64_t offset = 0;
+    std::string line;
+    bool ok = true;
+
+    for (const auto& e : index) {
+        if (!read_locked(e.second, line) || !write_all(tfd, line.data(), line.size())) {
+            ok = false;
+            break;
+        }
+        new_index.emplace(e.first, entry{offset, e.second.length});
+        offset += line.size();
+    }
+
+    if (ok)
+        ok = fsync(tfd) == 0;
+    close(tfd);
+
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) < 0) {
+        unlink(tmp_path.c_str());
+        return;
+    }
+
+    int nfd = ::open(path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    if (nfd < 0) {
+        // The rewrite is in place but we can't append to it; stop spilling
+        close(fd);
+        fd = -1;
+        index.clear();
+        live_bytes = end_offset = 0;
+        return;
+    }
+
+    close(fd);
+    fd = nfd;
+    index = std::move(new_index);
+    end_offset = live_bytes = offset;
+}
@@ -0,0 +1,73 @@
+/*
+ * On-disk store for idle cells
+ *
+ * Cells that have not been heard for a while are moved out of memory: their
+ * full PHY state is appended to a JSON-lines file and only the file offset is
+ * kept, keyed by the stable cell key.  When the cell is heard again its state
+ * is read back and the record is marked taken.
+ *
+ * Records are only ever appended; a key's newest line wins.  The index is
+ * rebuilt by scanning the file on open, so spilled cells survive a restart.
+ * put and take only append; compact rewrites the file with just the live
+ * records once dead lines make up most of it, and is left to the caller so
+ * the rewrite and fsync happen where they can't hold up packets.
+ */
+
+#ifndef __CELL_SPILL_H__
+#define __CELL_SPILL_H__
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class cell_spill_store {
+public:
+    cell_spill_store() { }
+    ~cell_spill_store();
+
+    cell_spill_store(const cell_spill_store&) = delete;
+    cell_spill_store& operator=(const cell_spill_store&) = delete;
+
+    // Open or create the store at path and index any records already in it.
+    // A partial last line (crash mid-write) is cut off.  On failure err is
+    // set and the store stays closed.
+    bool open(const std::string& path, std::string& err);
+
+    bool is_open() const;
+
+    // Write the state for key, replacing any earlier copy.  payload must be
+    // a JSON object.
+    bool put(const std::string& key, const std::string& payload);
+
+    // Move the state for key out of the store.  Returns false if the key is
+    // not spilled or its record can't be read back.
+    bool take(const std::string& key, std::string& payload);
+
+    // Rewrite the file without dead lines if they make up most of it.  Blocks
+    // put and take for the length of the rewrite.
+    void compact();
+
+    size_t size() const;
+    uint64_t file_bytes() const;
+
+protected:
+    struct entry {
+        uint64_t offset = 0;
+        uint32_t length = 0;    // whole line, including the newline
+    };
+
+    bool append_locked(const std::string& line, uint64_t& offset);
+    bool read_locked(const entry& e, std::string& line) const;
+    void compact_locked();
+
+    mutable std::mutex mutex;
+    std::string path;
+    int fd = -1;
+
+    uint64_t end_offset = 0;
+    uint64_t live_bytes = 0;
+    std::unordered_map<std::string, entry> index;
+};
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Compact per-cell summary table; see cell_summary.h
+ */
+
+#include "cell_summary.h"
+
+#include <sys/time.h>
+
+#include <nlohmann/json.hpp>
+
+const std::vector<std::string>& cell_summary_table::columns() {
+    static const std::vector<std::string> cols = {
+        "key", "rat", "mcc", "mnc", "tac", "cid", "pci", "arfcn", "band",
+        "signal", "best_signal", "first_seen", "last_seen", "packets",
+        "tower_lat", "tower_lon",
+    };
+    return cols;
+}
+
+double cell_summary_table::stamp_locked() const {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    double now = tv.tv_sec + tv.tv_usec / 1000000.0;
+    if (now <= last_stamp)
+        now = last_stamp + 0.000001;
+    last_stamp = now;
+
+    return now;
+}
+
+bool cell_summary_table::erase(const std::string& key) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    auto ri = index.find(key);
+    if (ri == index.end())
+        return false;
+
+    rows.erase(ri->second);
+    index.erase(ri);
+    return true;
+}
+
+bool cell_summary_table::contains(const std::string& key) const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return index.find(key) != index.end();
+}
+
+size_t cell_summary_table::take_idle(double before, size_t max,
+        std::vector<cell_summary_row>& out) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    // Rows are in modification order, so the idle ones are all at the front
+    size_t n = 0;
+    while (n < max && !rows.empty() && rows.front().updated < before) {
+        index.erase(rows.front().key);
+        out.push_back(std::move(rows.front()));
+        rows.pop_front();
+        n++;
+    }
+
+    return n;
+}
+
+void cell_summary_table::restore(cell_summary_row row) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    if (index.find(row.key) != index.end())
+        return;
+
+    row.updated = stamp_locked();
+    rows.push_back(std::move(row));
+    index.emplace(rows.back().key, std::prev(rows.end()));
+}
+
+size_t cell_summary_table::size() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return rows.size();
+}
+
+std::string cell_summary_table::dump_since(double since, size_t limit) const {
+    nlohmann::json cells = nlohmann::json::array();
+    double ts;
+
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+
+        ts = stamp_locked();
+
+        // Walk back from the newest row to the first one the client hasn't seen
+        auto ri = rows.rbegin();
+        while (ri != rows.rend() && ri->updated > since)
+            ++ri;
+
+        // Then emit oldest-first, so a truncated reply resumes cleanly from
+        // the stamp of the last row sent
+        for (auto fi = ri.base(); fi != rows.end(); ++fi) {
+            if (limit && cells.size() >= limit) {
+                ts = std::prev(fi)->updated;
+                break;
+            }
+
+            const auto& r = *fi;
+            cells.push_back({
+                    r.key, r.rat, r.mcc, r.mnc, r.tac, r.cid, r.pci, r.arfcn, r.band,
+                    r.has_signal ? nlohmann::json(r.signal) : nlohmann::json(),
+                    r.has_signal ? nlohmann::json(r.best_signal) : nlohmann::json(),
+                    r.first_seen, r.last_seen, r.packets,
+                    r.has_tower ? nlohmann::json(r.tower_lat) : nlohmann::json(),
+                    r.has_tower ? nlohmann::json(r.tower_lon) : nlohmann::json(),
+                    });
+        }
+    }
+
+    nlohmann::json out = {
+        {"ts", ts},
+        {"columns", columns()},
+        {"cells", std::move(cells)},
+    };
+
+    return out.dump();
+}
@@ -0,0 +1,123 @@
+/*
+ * Compact per-cell summary table
+ *
+ * The PHY keeps one fixed-schema row per cell alongside the device record so
+ * the UI can poll a small table instead of serializing full devices.  Rows are
+ * held in update order, so a "changed since" query walks only the rows that
+ * actually changed.
+ */
+
+#ifndef __CELL_SUMMARY_H__
+#define __CELL_SUMMARY_H__
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct cell_summary_row {
+    std::string key;
+    std::string rat;
+    std::string mcc;
+    std::string mnc;
+    std::string tac;
+    std::string cid;
+    std::string pci;
+    std::string arfcn;
+    std::string band;
+
+    bool has_signal = false;
+    int signal = 0;
+    int best_signal = 0;
+
+    double first_seen = 0;
+    double last_seen = 0;
+    uint64_t packets = 0;
+
+    bool has_tower = false;
+    double tower_lat = 0;
+    double tower_lon = 0;
+
+    // Hash the Kismet device MAC is derived from; not serialized
+    uint64_t device_hash = 0;
+
+    // Server-side modification stamp used for delta queries
+    double updated = 0;
+};
+
+class cell_summary_table {
+public:
+    cell_summary_table() { }
+
+    // Field order of each row in the serialized form
+    static const std::vector<std::string>& columns();
+
+    // Create or fetch the row for key, let fn mutate it, and stamp it as
+    // changed.  Returns true when the row was created.
+    template<typename F>
+    bool update(const std::string& key, double seen, F&& fn) {
+        std::lock_guard<std::mutex> lk(mutex);
+
+        bool created = false;
+        auto ri = index.find(key);
+        if (ri == index.end()) {
+            rows.emplace_back();
+            rows.back().key = key;
+            rows.back().first_seen = seen;
+            ri = index.emplace(key, std::prev(rows.end())).first;
+            created = true;
+        } else {
+            // Move to the tail; rows stay ordered by modification stamp
+            rows.splice(rows.end(), rows, ri->second);
+        }
+
+        auto& row = *ri->second;
+        row.last_seen = seen;
+        row.packets++;
+        fn(row);
+        row.updated = stamp_locked();
+
+        return created;
+    }
+
+    bool erase(const std::string& key);
+
+    bool contains(const std::string& key) const;
+
+    // Call fn on every row, oldest change first, with the table locked
+    template<typename F>
+    void for_each(F&& fn) const {
+        std::lock_guard<std::mutex> lk(mutex);
+        for (const auto& row : rows)
+            fn(row);
+    }
+
+    // Remove up to max rows last changed before the server time before,
+    // oldest first, appending them to out.  Returns the number removed.
+    size_t take_idle(double before, size_t max, std::vector<cell_summary_row>& out);
+
+    // Put back a row from take_idle; an existing row for the key wins
+    void restore(cell_summary_row row);
+
+    size_t size() const;
+
+    // Serialize rows changed after since (0 for all) as
+    //   {"ts": <stamp>, "columns": [...], "cells": [[...], ...]}
+    // Pass the returned ts back as since to fetch the next delta.
+    std::string dump_since(double since, size_t limit) const;
+
+protected:
+    double stamp_locked() const;
+
+    mutable std::mutex mutex;
+    std::list<cell_summary_row> rows;
+    std::unordered_map<std::string, std::list<cell_summary_row>::iterator> index;
+
+    // Highest stamp handed out, so a row can never be stamped at or before a
+    // ts a client already holds
+    mutable double last_stamp = 0;
+};
+
+#endif
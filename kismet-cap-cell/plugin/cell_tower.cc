@@ -0,0 +1,443 @@
+/*
+ * Incremental transmitter position estimate for cells; see cell_tower.h
+ */
+
+#include "cell_tower.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr double m_per_deg_lat = 111320.0;
+    constexpr double deg_to_rad = M_PI / 180.0;
+
+    // Floor on reported uncertainty; below this the estimate is noise anyway
+    constexpr double min_radius_m = 50.0;
+
+    // LTE TA is reported in units of 16 Ts (78.12m one-way), GSM in bit periods
+    constexpr double lte_ta_step_m = 78.12;
+    constexpr double gsm_ta_step_m = 553.85;
+
+    double haversine_m(double lat1, double lon1, double lat2, double lon2) {
+        double dlat = (lat2 - lat1) * deg_to_rad;
+        double dlon = (lon2 - lon1) * deg_to_rad;
+        double a = std::sin(dlat / 2) * std::sin(dlat / 2) +
+            std::cos(lat1 * deg_to_rad) * std::cos(lat2 * deg_to_rad) *
+            std::sin(dlon / 2) * std::sin(dlon / 2);
+        return 6371000.0 * 2 * std::atan2(std::sqrt(a), std::sqrt(1 - a));
+    }
+}
+
+cell_tower_index::cell_tower_index(double grid_deg) :
+    grid_deg{grid_deg > 0 ? grid_deg : 0.01} { }
+
+double cell_tower_index::ta_distance_m(const std::string& rat, int ta) {
+    if (rat == "LTE") {
+        if (ta < 0 || ta > 1282)
+            return -1;
+        return ta * lte_ta_step_m;
+    }
+
+    if (rat == "GSM") {
+        if (ta < 0 || ta > 63)
+            return -1;
+        return ta * gsm_ta_step_m;
+    }
+
+    return -1;
+}
+
+bool cell_tower_index::valid_position(double lat, double lon) {
+    return std::isfinite(lat) && std::isfinite(lon) &&
+        lat >= -90.0 && lat <= 90.0 && lon >= -180.0 && lon <= 180.0;
+}
+
+uint64_t cell_tower_index::bucket_for(double lat, double lon) const {
+    // Clamped into the grid, as cell_heatmap::tile_for does, so the casts
+    // stay defined for any input
+    double n_lat = std::ceil(180.0 / grid_deg);
+    double n_lon = std::ceil(360.0 / grid_deg);
+    auto ilat = static_cast<uint32_t>(std::max(0.0, std::min(n_lat - 1, std::floor((lat + 90.0) / grid_deg))));
+    auto ilon = static_cast<uint32_t>(std::max(0.0, std::min(n_lon - 1, std::floor((lon + 180.0) / grid_deg))));
+    return (static_cast<uint64_t>(ilat) << 32) | ilon;
+}
+
+void cell_tower_index::recompute(tower_state& st) const {
+    auto& est = st.est;
+
+    if (st.sw <= 0)
+        return;
+
+    // Counts from the live sums alone; a restored prior is blended in last
+    double live_n = std::max(0.0, static_cast<double>(est.samples) - st.prior_samples);
+    double live_ta = std::max(0.0, static_cast<double>(est.ta_samples) - st.prior_ta_samples);
+
+    double mx = st.swx / st.sw;
+    double my = st.swy / st.sw;
+    double spread = std::sqrt(std::max(0.0, st.swxx / st.sw - mx * mx) +
+            std::max(0.0, st.swyy / st.sw - my * my));
+
+    double ex = mx, ey = my;
+    double radius = std::max(spread, min_radius_m);
+    bool from_ta = false;
+
+    if (live_ta >= 3) {
+        // Cramer's rule on the symmetric 3x3 normal equations
+        double a = st.aa_xx, b = st.aa_xy, c = st.aa_x1;
+        double d = st.aa_yy, e = st.aa_y1, f = st.aa_11;
+
+        double c00 = d * f - e * e;
+        double c01 = c * e - b * f;
+        double c02 = b * e - c * d;
+        double det = a * c00 + b * c01 + c * c02;
+
+        // Reject near-singular systems, i.e. every TA sample taken along a line
+        if (std::fabs(det) > 1e-6 * std::fabs(a * d * f)) {
+            double c11 = a * f - c * c;
+            double c12 = b * c - a * e;
+            double c22 = a * d - b * b;
+
+            double tx = (c00 * st.ab_x + c01 * st.ab_y + c02 * st.ab_1) / det;
+            double ty = (c01 * st.ab_x + c11 * st.ab_y + c12 * st.ab_1) / det;
+            double tc = (c02 * st.ab_x + c12 * st.ab_y + c22 * st.ab_1) / det;
+
+            // Residual of the linear system without keeping the rows around
+            double mtheta_x = a * tx + b * ty + c * tc;
+            double mtheta_y = b * tx + d * ty + e * tc;
+            double mtheta_1 = c * tx + e * ty + f * tc;
+            double resid = tx * mtheta_x + ty * mtheta_y + tc * mtheta_1 -
+                2 * (tx * st.ab_x + ty * st.ab_y + tc * st.ab_1) + st.sum_bb;
+
+            double n = live_ta;
+            double mean_d = std::max(st.sum_d / n, lte_ta_step_m);
+            double range_err = std::sqrt(std::max(0.0, resid) / n) / (2 * mean_d);
+
+            // A solution far outside the observed rings is a bad fit, not a tower
+            double off = std::hypot(tx - mx, ty - my);
+            if (std::isfinite(tx) && std::isfinite(ty) && off < 2 * (mean_d + spread) + 500.0) {
+                ex = tx;
+                ey = ty;
+                radius = std::max(range_err, min_radius_m);
+                from_ta = true;
+            }
+        }
+    }
+
+    // The prior sits at the origin, weighted by the samples it stood for
+    if (st.prior_samples > 0) {
+        double total = st.prior_samples + live_n;
+        ex = ex * live_n / total;
+        ey = ey * live_n / total;
+        radius = (st.prior_radius_m * st.prior_samples + radius * live_n) / total;
+        if (live_n < st.prior_samples)
+            from_ta = st.prior_from_ta;
+    }
+
+    est.lat = st.lat0 + ey / m_per_deg_lat;
+    est.lon = st.lon0 + (st.m_per_deg_lon > 0 ? ex / st.m_per_deg_lon : 0);
+    est.radius_m = radius;
+    est.from_ta = from_ta;
+}
+
+void cell_tower_index::unbucket(const std::string *key, tower_state& st) {
+    if (!st.bucketed)
+        return;
+
+    auto gi = grid.find(st.bucket);
+    if (gi != grid.end()) {
+        gi->second.erase(key);
+        if (gi->second.empty())
+            grid.erase(gi);
+    }
+
+    st.bucketed = false;
+}
+
+void cell_tower_index::rebucket(const std::string *key, tower_state& st) {
+    auto b = bucket_for(st.est.lat, st.est.lon);
+
+    if (st.bucketed && b == st.bucket)
+        return;
+
+    unbucket(key, st);
+    grid[b].insert(key);
+    st.bucket = b;
+    st.bucketed = true;
+}
+
+cell_tower_estimate cell_tower_index::observe(const std::string& key, double lat, double lon,
+        bool has_signal, int signal_dbm, double ta_m) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    if (!valid_position(lat, lon)) {
+        auto ti = towers.find(key);
+        return ti == towers.end() ? cell_tower_estimate{} : ti->second.est;
+    }
+
+    auto ins = towers.emplace(key, tower_state{});
+    auto& st = ins.first->second;
+
+    if (ins.second || (st.sw <= 0 && st.prior_samples <= 0)) {
+        st.lat0 = lat;
+        st.lon0 = lon;
+        st.m_per_deg_lon = m_per_deg_lat * std::cos(lat * deg_to_rad);
+    }
+
+    double x = (lon - st.lon0) * st.m_per_deg_lon;
+    double y = (lat - st.lat0) * m_per_deg_lat;
+
+    // Amplitude-domain weight so one strong sample doesn't swamp the rest
+    double w = 1.0;
+    if (has_signal)
+        w = std::pow(10.0, (std::clamp(signal_dbm, -140, -30) + 140) / 20.0);
+
+    st.sw += w;
+    st.swx += w * x;
+    st.swy += w * y;
+    st.swxx += w * x * x;
+    st.swyy += w * y * y;
+
+    if (ta_m >= 0) {
+        double b = ta_m * ta_m - x * x - y * y;
+        st.aa_xx += 4 * x * x;
+        st.aa_xy += 4 * x * y;
+        st.aa_x1 += -2 * x;
+        st.aa_yy += 4 * y * y;
+        st.aa_y1 += -2 * y;
+        st.aa_11 += 1;
+        st.ab_x += -2 * x * b;
+        st.ab_y += -2 * y * b;
+        st.ab_1 += b;
+        st.sum_bb += b * b;
+        st.sum_d += ta_m;
+        st.est.ta_samples++;
+    }
+
+    st.est.samples++;
+
+    recompute(st);
+    rebucket(&ins.first->first, st);
+
+    return st.est;
+}
+
+std::optional<cell_tower_estimate> cell_tower_index::estimate(const std::string& key) const {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    auto ti = towers.find(key);
+    if (ti == towers.end() || ti->second.est.samples == 0)
+        return std::nullopt;
+
+    return ti->second.est;
+}
+
+void cell_tower_index::restore(const std::string& key, const cell_tower_estimate& est) {
+    if (!valid_position(est.lat, est.lon))
+        return;
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    auto ins = towers.emplace(key, tower_state{});
+    auto& st = ins.first->second;
+
+    // Live sums win over a restored estimate
+    if (!ins.second && st.sw > 0)
+        return;
+
+    st.lat0 = est.lat;
+    st.lon0 = est.lon;
+    st.m_per_deg_lon = m_per_deg_lat * std::cos(est.lat * deg_to_rad);
+    st.prior_samples = static_cast<double>(est.samples);
+    st.prior_ta_samples = static_cast<double>(est.ta_samples);
+    st.prior_radius_m = est.radius_m;
+    st.prior_from_ta = est.from_ta;
+    st.est = est;
+    rebucket(&ins.first->first, st);
+}
+
+void cell_tower_index::erase(const std::string& key) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    auto ti = towers.find(key);
+    if (ti == towers.end())
+        return;
+
+    unbucket(&ti->first, ti->second);
+    towers.erase(ti);
+}
+
+bool cell_tower_index::take(const std::string& key, tower_state& out) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    auto ti = towers.find(key);
+    if (ti == towers.end())
+        return false;
+
+    unbucket(&ti->first, ti->second);
+    out = ti->second;
+    towers.erase(ti);
+    return true;
+}
+
+void cell_tower_index::put(const std::string& key, const tower_state& in) {
+    std::lock_guard<std::mutex> lk(mutex);
+
+    auto ins = towers.emplace(key, in);
+    if (!ins.second)
+        return;
+
+    auto& st = ins.first->second;
+    st.bucketed = false;
+    if (st.est.samples > 0)
+        rebucket(&ins.first->first, st);
+}
+
+std::vector<double> cell_tower_index::pack(const tower_state& st) {
+    return {
+        st.lat0, st.lon0, st.m_per_deg_lon,
+        st.sw, st.swx, st.swy, st.swxx, st.swyy,
+        st.aa_xx, st.aa_xy, st.aa_x1, st.aa_yy, st.aa_y1, st.aa_11,
+        st.ab_x, st.ab_y, st.ab_1, st.sum_bb, st.sum_d,
+        st.est.lat, st.est.lon, st.est.radius_m,
+        static_cast<double>(st.est.samples), static_cast<double>(st.est.ta_samples),
+        st.est.from_ta ? 1.0 : 0.0,
+        st.prior_samples, st.prior_ta_samples, st.prior_radius_m,
+        st.prior_from_ta ? 1.0 : 0.0,
+    };
+}
+
+bool cell_tower_index::unpack(const std::vector<double>& v, tower_state& st) {
+    if (v.size() != 25 && v.size() != 29)
+        return false;
+
+    st = tower_state{};
+    st.lat0 = v[0];
+    st.lon0 = v[1];
+    st.m_per_deg_lon = v[2];
+    st.sw = v[3];
+    st.swx = v[4];
+    st.swy = v[5];
+    st.swxx = v[6];
+    st.swyy = v[7];
+    st.aa_xx = v[8];
+    st.aa_xy = v[9];
+    st.aa_x1 = v[10];
+    st.aa_yy = v[11];
+    st.aa_y1 = v[12];
+    st.aa_11 = v[13];
+    st.ab_x = v[14];
+    st.ab_y = v[15];
+    st.ab_1 = v[16];
+    st.sum_bb = v[17];
+    st.sum_d = v[18];
+    st.est.lat = v[19];
+    st.est.lon = v[20];
+    st.est.radius_m = v[21];
+    st.est.samples = static_cast<uint64_t>(v[22]);
+    st.est.ta_samples = static_cast<uint64_t>(v[23]);
+    st.est.from_ta = v[24] != 0;
+
+    if (v.size() == 29) {
+        st.prior_samples = v[25];
+        st.prior_ta_samples = v[26];
+        st.prior_radius_m = v[27];
+        st.prior_from_ta = v[28] != 0;
+    }
+
+    return true;
+}
+
+size_t cell_tower_index::size() const {
+    std::lock_guard<std::mutex> lk(mutex);
+    return towers.size();
+}
+
+cell_tower_index::result_vec cell_tower_index::collect(double min_lat, double min_lon,
+        double max_lat, double max_lon, size_t limit,
+        const std::function<bool (const cell_tower_estimate&)>& filter) const {
+    result_vec ret;
+
+    if (!std::isfinite(min_lat) || !std::isfinite(min_lon) ||
+            !std::isfinite(max_lat) || !std::isfinite(max_lon))
+        return ret;
+
+    // Areas reaching past the poles or the antimeridian stop at the edge
+    min_lat = std::max(min_lat, -90.0);
+    min_lon = std::max(min_lon, -180.0);
+    max_lat = std::min(max_lat, 90.0);
+    max_lon = std::min(max_lon, 180.0);
+    if (min_lat > max_lat || min_lon > max_lon)
+        return ret;
+
+    auto in_box = [&](const cell_tower_estimate& e) {
+        return e.lat >= min_lat && e.lat <= max_lat && e.lon >= min_lon && e.lon <= max_lon &&
+            (!filter || filter(e));
+    };
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    double lat_cells = std::floor((max_lat + 90.0) / grid_deg) - std::floor((min_lat + 90.0) / grid_deg) + 1;
+    double lon_cells = std::floor((max_lon + 180.0) / grid_deg) - std::floor((min_lon + 180.0) / grid_deg) + 1;
+
+    // Huge boxes touch more buckets than there are towers; just walk the towers
+    if (lat_cells * lon_cells > static_cast<double>(grid.size())) {
+        for (const auto& t : towers) {
+            if (limit && ret.size() >= limit)
+                break;
+            if (t.second.est.samples && in_box(t.second.est))
+                ret.emplace_back(t.first, t.second.est);
+        }
+        return ret;
+    }
+
+    auto lo = bucket_for(min_lat, min_lon);
+    auto hi = bucket_for(max_lat, max_lon);
+    for (uint64_t ilat = lo >> 32; ilat <= hi >> 32; ilat++) {
+        for (uint64_t ilon = lo & 0xFFFFFFFF; ilon <= (hi & 0xFFFFFFFF); ilon++) {
+            auto gi = grid.find((ilat << 32) | ilon);
+            if (gi == grid.end())
+                continue;
+
+            for (const auto *k : gi->second) {
+                if (limit && ret.size() >= limit)
+                    return ret;
+
+                const auto& est = towers.at(*k).est;
+                if (in_box(est))
+                    ret.emplace_back(*k, est);
+            }
+        }
+    }
+
+    return ret;
+}
+
+cell_tower_index::result_vec cell_tower_index::in_bbox(double min_lat, double min_lon,
+        double max_lat, double max_lon, size_t limit) const {
+    return collect(std::min(min_lat, max_lat), std::min(min_lon, max_lon),
+            std::max(min_lat, max_lat), std::max(min_lon, max_lon), limit, nullptr);
+}
+
+cell_tower_index::result_vec cell_tower_index::near(double lat, double lon, double radius_m,
+        size_t limit) const {
+    if (!valid_position(lat, lon) || !(radius_m >= 0))
+        return {};
+
+    double dlat = radius_m / m_per_deg_lat;
+    double dlon = radius_m / std::max(1.0, m_per_deg_lat * std::cos(lat * deg_to_rad));
+
+    auto ret = collect(lat - dlat, lon - dlon, lat + dlat, lon + dlon, 0,
+            [&](const cell_tower_estimate& e) {
+                return haversine_m(lat, lon, e.lat, e.lon) <= radius_m;
+            });
+
+    std::sort(ret.begin(), ret.end(), [&](const auto& a, const auto& b) {
+            return haversine_m(lat, lon, a.second.lat, a.second.lon) <
+                haversine_m(lat, lon, b.second.lat, b.second.lon);
+            });
+
+    if (limit && ret.size() > limit)
+        ret.resize(limit);
+
+    return ret;
+}
@@ -0,0 +1,124 @@
+/*
+ * Incremental transmitter position estimate for cells
+ *
+ * Every observation of a cell that carries a phone position is folded into a
+ * handful of running sums; no samples are stored.  Two estimators are fed:
+ *
+ *  - a signal-weighted centroid of the phone positions, and
+ *  - a linearised least-squares fit of the timing-advance rings
+ *    (|p - t|^2 = d^2 rewritten as -2p.t + |t|^2 = d^2 - |p|^2), whose 3x3
+ *    normal equations are accumulated and solved on update.
+ *
+ * The TA fit is preferred once it is well conditioned; otherwise the centroid
+ * is used.  Estimates are kept in a uniform lat/lon grid so area lookups only
+ * visit the buckets they overlap.
+ */
+
+#ifndef __CELL_TOWER_H__
+#define __CELL_TOWER_H__
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct cell_tower_estimate {
+    double lat = 0;
+    double lon = 0;
+    double radius_m = 0;        // rough 1-sigma uncertainty
+    uint64_t samples = 0;
+    uint64_t ta_samples = 0;
+    bool from_ta = false;
+};
+
+class cell_tower_index {
+public:
+    // grid_deg is the spatial bucket size; ~0.01 deg is ~1.1 km N/S
+    explicit cell_tower_index(double grid_deg = 0.01);
+
+    // Distance in metres implied by a timing advance report, or a negative
+    // value when the RAT has no usable TA or the report is out of range.
+    static double ta_distance_m(const std::string& rat, int ta);
+
+    // Finite and within [-90, 90] / [-180, 180]
+    static bool valid_position(double lat, double lon);
+
+    // Fold one observation into the estimate for key.  signal_dbm is ignored
+    // unless has_signal; ta_m < 0 means no TA.  Returns the updated estimate;
+    // an invalid position is ignored and the current one returned.
+    cell_tower_estimate observe(const std::string& key, double lat, double lon,
+            bool has_signal, int signal_dbm, double ta_m);
+
+    std::optional<cell_tower_estimate> estimate(const std::string& key) const;
+
+    typedef std::vector<std::pair<std::string, cell_tower_estimate>> result_vec;
+
+    result_vec near(double lat, double lon, double radius_m, size_t limit) const;
+    result_vec in_bbox(double min_lat, double min_lon, double max_lat, double max_lon,
+            size_t limit) const;
+
+    // Seed an estimate without sample history (warm start).  It is kept as
+    // a prior worth est.samples observations at its position, and blended
+    // with the fit from live observations as they arrive.
+    void restore(const std::string& key, const cell_tower_estimate& est);
+
+    // Drop an estimate entirely
+    void erase(const std::string& key);
+
+    size_t size() const;
+
+    struct tower_state {
+        // Local tangent-plane origin; the first observation of the cell
+        double lat0 = 0, lon0 = 0, m_per_deg_lon = 0;
+
+        // Weighted centroid sums
+        double sw = 0, swx = 0, swy = 0, swxx = 0, swyy = 0;
+
+        // TA normal equations: A^T A (symmetric) and A^T b, rows [-2x, -2y, 1]
+        double aa_xx = 0, aa_xy = 0, aa_x1 = 0, aa_yy = 0, aa_y1 = 0, aa_11 = 0;
+        double ab_x = 0, ab_y = 0, ab_1 = 0;
+        double sum_bb = 0, sum_d = 0;
+
+        // Warm-start prior at the origin; its counts are included in est
+        double prior_samples = 0, prior_ta_samples = 0, prior_radius_m = 0;
+        bool prior_from_ta = false;
+
+        cell_tower_estimate est;
+        uint64_t bucket = 0;
+        bool bucketed = false;
+    };
+
+    // Remove a cell and hand back its full accumulated state, so it can be
+    // kept out of memory while the cell is idle
+    bool take(const std::string& key, tower_state& out);
+
+    // Reinstate state from take(); live sums for the key win
+    void put(const std::string& key, const tower_state& st);
+
+    // Flat form of tower_state for storage; unpack also takes the shorter
+    // form written before priors existed and rejects any other length
+    static std::vector<double> pack(const tower_state& st);
+    static bool unpack(const std::vector<double>& v, tower_state& st);
+
+protected:
+    uint64_t bucket_for(double lat, double lon) const;
+    void recompute(tower_state& st) const;
+    void rebucket(const std::string *key, tower_state& st);
+    void unbucket(const std::string *key, tower_state& st);
+
+    result_vec collect(double min_lat, double min_lon, double max_lat, double max_lon,
+            size_t limit, const std::function<bool (const cell_tower_estimate&)>& filter) const;
+
+    double grid_deg;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, tower_state> towers;
+    // Bucket -> keys; key pointers reference the (node-stable) towers map
+    std::unordered_map<uint64_t, std::unordered_set<const std::string *>> grid;
+};
+
+#endif
@@ -43,6 +43,10 @@
                 ["RSRP", "cell.device.rsrp"],
                 ["RSRQ", "cell.device.rsrq"],
                 ["Band", "cell.device.band"],
+                ["Tower Lat", "cell.device.tower_lat"],
+                ["Tower Lon", "cell.device.tower_lon"],
+                ["Tower Radius (m)", "cell.device.tower_radius_m"],
+                ["Tower Samples", "cell.device.tower_samples"],
                 ["Composite", "cell.full_composite"]
             ];
 
@@ -66,7 +70,12 @@
                 table.append(tr);
             }
 
+            // Tower estimate fields are zero until a located observation arrives
+            var hasTower = Number(getVal("cell.device.tower_samples")) > 0;
+
             fields.forEach(function(f) {
+                if (!hasTower && f[1].indexOf("cell.device.tower_") === 0)
+                    return;
                 addRow(f[0], getVal(f[1]));
             });
 
@@ -96,4 +105,86 @@
             element.append(table);
         }
     });
+
+    // Cells tab, fed from the plugin's compact summary endpoint.  Only rows
+    // changed since the previous poll are fetched; the full set lives here.
+    if (typeof(kismet_ui_tabpane) === 'undefined') {
+        return;
+    }
+
+    var cellSummary = {
+        since: 0,
+        columns: [],
+        rows: {},
+        maxDisplay: 250,
+        pollMs: 2000,
+        element: null
+    };
+
+    function cellSummaryRender() {
+        if (cellSummary.element === null)
+            return;
+
+        var col = {};
+        cellSummary.columns.forEach(function(c, i) { col[c] = i; });
+
+        var rows = Object.keys(cellSummary.rows).map(function(k) {
+            return cellSummary.rows[k];
+        });
+        rows.sort(function(a, b) { return b[col.last_seen] - a[col.last_seen]; });
+
+        var shown = [
+            ["Cell", "key"], ["RAT", "rat"], ["MCC", "mcc"], ["MNC", "mnc"],
+            ["Band", "band"], ["PCI", "pci"], ["ARFCN", "arfcn"],
+            ["Signal", "signal"], ["Best", "best_signal"], ["Packets", "packets"]
+        ];
+
+        var table = $('<table>', { 'class': 'tablelist' });
+        var hdr = $('<tr>');
+        shown.forEach(function(s) { hdr.append($('<th>').text(s[0])); });
+        hdr.append($('<th>').text("Last Seen"));
+        table.append(hdr);
+
+        rows.slice(0, cellSummary.maxDisplay).forEach(function(r) {
+            var tr = $('<tr>');
+            shown.forEach(function(s) {
+                var v = r[col[s[1]]];
+                tr.append($('<td>').text(v === null || v === undefined ? "" : v));
+            });
+            tr.append($('<td>').text(new Date(r[col.last_seen] * 1000).toLocaleTimeString()));
+            table.append(tr);
+        });
+
+        cellSummary.element.empty();
+        cellSummary.element.append($('<div>').text(rows.length + " cells"));
+        cellSummary.element.append(table);
+    }
+
+    function cellSummaryPoll() {
+        $.get(local_uri_prefix + "phy/cell/summary.json?since=" + cellSummary.since)
+        .done(function(data) {
+            data = kismet.sanitizeObject(data);
+            cellSummary.columns = data.columns;
+            cellSummary.since = data.ts;
+            if (data.cells.length > 0) {
+                data.cells.forEach(function(r) { cellSummary.rows[r[0]] = r; });
+                cellSummaryRender();
+            }
+        })
+        .always(function() {
+            setTimeout(cellSummaryPoll, cellSummary.pollMs);
+        });
+    }
+
+    kismet_ui_tabpane.AddTab({
+        id: 'cell_summary',
+        tabTitle: 'Cells',
+        createCallback: function(div) {
+            cellSummary.element = $(div);
+            cellSummaryRender();
+        },
+        priority: -100
+    }, 'south');
+
+    cellSummaryPoll();
 })();
@@ -0,0 +1,78 @@
+#!/usr/bin/env bash
+# Train the shared zstd dictionary for compressed phone streams.
+#
+#   ./train_zstd_dict.sh [OUT] [raw-stream.jsonl ...]
+#
+# Samples are the phone JSON lines given as arguments (raw phone output, e.g.
+# `nc 127.0.0.1 8765 > raw.jsonl`), plus records synthesized from the
+# SCHEMA.md examples so the field names and layout are covered even without
+# captures.  Install OUT as /etc/kismet/cell.zdict on the Pi
+# (source option zdict=) and as app/src/main/assets/cell.zdict in the app.
+set -euo pipefail
+SRC_DIR=$(cd -- "$(dirname "$0")" && pwd)
+OUT="${1:-cell.zdict}"
+[[ $# -gt 0 ]] && shift
+
+command -v zstd >/dev/null || { echo "zstd not found (apt install zstd)" >&2; exit 1; }
+
+SAMPLES="$(mktemp -d)"
+trap 'rm -rf "${SAMPLES}"' EXIT
+
+python3 - "${SRC_DIR}/SCHEMA.md" "${SAMPLES}" "$@" <<'EOF'
+import json
+import random
+import re
+import sys
+
+schema_path, out_dir, captures = sys.argv[1], sys.argv[2], sys.argv[3:]
+
+# The two ```json blocks: the top-level frame, then one cell entry
+blocks = re.findall(r"```json\n(.*?)```", open(schema_path, encoding="utf-8").read(), re.S)
+
+def strip(block):
+    # Drop comments and the elided cell list; "LTE|NR|..." becomes "LTE"
+    block = re.sub(r"//[^\n]*", "", block)
+    block = re.sub(r'\[\s*\{[^\]]*\]', "[]", block)
+    return json.loads(re.sub(r'"(\w+)\|[^"]*"', r'"\1"', block))
+
+frame_tmpl, cell_tmpl = strip(blocks[0]), strip(blocks[1])
+rng = random.Random(1)
+
+def fill(tmpl, rat):
+    out = {}
+    for k, v in tmpl.items():
+        if isinstance(v, bool):
+            out[k] = rng.random() < 0.2
+        elif isinstance(v, int):
+            out[k] = rng.randint(-130, 0) if k.startswith("rs") or k == "snr" else rng.randint(0, v * 2 + 10)
+        elif isinstance(v, float):
+            out[k] = round(v * rng.uniform(0.5, 1.5), 3)
+        elif v is None:
+            out[k] = None
+        else:
+            out[k] = v
+    out["rat"] = rat
+    return out
+
+n = 0
+for i in range(2000):
+    frame = dict(frame_tmpl)
+    frame["ts"] = 1700000000 + i * 2 + rng.random()
+    rat = rng.choice(["LTE", "NR", "WCDMA", "GSM"])
+    frame["network_type"] = rat
+    frame["cells"] = [fill(cell_tmpl, rat) for _ in range(rng.randint(1, 8))]
+    with open(f"{out_dir}/s{n}.json", "w") as f:
+        f.write(json.dumps(frame, separators=(",", ":")) + "\n")
+    n += 1
+
+for path in captures:
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            if line.startswith("{"):
+                with open(f"{out_dir}/s{n}.json", "w") as o:
+                    o.write(line)
+                n += 1
+EOF
+
+zstd -q -f --train -r "${SAMPLES}" --maxdict=16384 -o "${OUT}"
+echo "wrote ${OUT}"
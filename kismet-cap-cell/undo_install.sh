@@ -63,6 +63,7 @@ rm -f \
   "${BIN_DIR}/cell_autoconfig.sh" \
   "${BIN_DIR}/kismet_cell_injector.sh" \
   "${BIN_DIR}/cell_remote_bridge.py" \
+  "${BIN_DIR}/kismet_cell_relay" \
   "${BIN_DIR}/uds_forwarder.py" \
   "${BIN_DIR}/cell_transport_toggle.sh" \
   "${BIN_DIR}/cell-transport-mode" \
@@ -76,6 +77,7 @@ rmdir "${PLUGIN_DIR}" 2>/dev/null || true
 
 rm -f /etc/kismet/datasources.d/cell.conf
 rm -f /var/lib/kismet/cell/sources.generated /var/lib/kismet/cell/portmap.tsv
+rm -f /var/lib/kismet/cell/spill.jsonl /var/lib/kismet/cell/spill.jsonl.tmp /var/lib/kismet/cell/knowledge.kb /var/lib/kismet/cell/knowledge.kb.tmp
 rm -rf /var/log/kismet/cell-bridge
 
 if [[ "${REMOVE_KISMET}" == "1" ]]; then
@@ -55,6 +55,7 @@ for f in \
   "${BIN_DIR}/cell_transport_toggle.sh" \
   "${BIN_DIR}/cell-transport-mode" \
   "${BIN_DIR}/collector.py" \
+  "${BIN_DIR}/kismet_cell_relay" \
   "${BIN_DIR}/uds_forwarder.py"; do
   [[ -f "${f}" ]] && rm -f "${f}"
 done
@@ -68,6 +69,7 @@ rmdir "${PLUGIN_DIR}" 2>/dev/null || true
 if [[ ${KEEP_CONFIG} -eq 0 ]]; then
   rm -f "${CONFIG_DS_DIR}/cell.conf"
   rm -f /var/lib/kismet/cell/sources.generated /var/lib/kismet/cell/portmap.tsv
+  rm -f /var/lib/kismet/cell/spill.jsonl /var/lib/kismet/cell/spill.jsonl.tmp /var/lib/kismet/cell/knowledge.kb /var/lib/kismet/cell/knowledge.kb.tmp
   rm -rf /var/log/kismet/cell-bridge
 fi
 